@@ -0,0 +1,40 @@
+#include <stdint.h>
+
+#include "BXWindow.hh"
+
+void BXWindow::set(uint32_t l1aBCID, uint32_t nBX)
+{
+  l1a = l1aBCID % OrbitLength;
+  n = nBX > MaxBX ? MaxBX : nBX;
+  first = (l1a + OrbitLength - l1aIndex()) % OrbitLength;
+}
+
+void BXWindow::fillBCIDs(uint32_t l1aBCID, uint32_t nBX, uint32_t *bcids)
+{
+  BXWindow window(l1aBCID, nBX);
+  uint32_t first = window.firstBCID();
+  nBX = window.nBX();
+  //A window is shorter than an orbit, so it wraps at most once
+  for(uint32_t i = 0; i < nBX; i++) {
+    uint32_t b = first + i;
+    bcids[i] = b - (b >= OrbitLength ? OrbitLength : 0);
+  }
+}
+
+/*
+ * BCIDs to BXs relative to l1aBCID, taking the shorter way round the
+ * orbit: BCID 0 is BX +1 of L1A 3563 and BCID 3563 is BX -1 of L1A 0.
+ */
+
+void BXWindow::toRelative(const uint32_t *bcids, uint32_t nBCIDs, uint32_t l1aBCID, int *relative)
+{
+  const int orbit = OrbitLength;
+  const int half = OrbitLength / 2;
+  int l1a = l1aBCID % OrbitLength;
+  for(uint32_t i = 0; i < nBCIDs; i++) {
+    int d = int(bcids[i]) - l1a;
+    d += (d < -half) ? orbit : 0;
+    d -= (d >= half) ? orbit : 0;
+    relative[i] = d;
+  }
+}
@@ -0,0 +1,62 @@
+#ifndef BXWindow_hh
+#define BXWindow_hh
+
+#include <stdint.h>
+
+/*
+ * The bunch crossings of a readout window of nBX BXs around an L1A.
+ *
+ * The L1A sits at index (nBX - 1) / 2 of the window, so odd windows are
+ * centred on it and even ones have one BX more after it. BCIDs wrap
+ * around the end of the orbit: L1A 3563 with nBX = 3 gives 3562, 3563, 0.
+ * Relative BXs count from the L1A (0) and are what BXVector ranges use.
+ */
+
+class BXWindow {
+
+public:
+
+  static const uint32_t OrbitLength = 3564;
+
+  // The DAQ header gives nBX in 8 bits
+  static const uint32_t MaxBX = 255;
+
+  BXWindow() : l1a(0), n(0), first(0) {;}
+  BXWindow(uint32_t l1aBCID, uint32_t nBX) {set(l1aBCID, nBX);}
+
+  // nBX is clipped to MaxBX and l1aBCID taken modulo the orbit
+  void set(uint32_t l1aBCID, uint32_t nBX);
+
+  uint32_t nBX() const {return n;}
+  uint32_t l1aBCID() const {return l1a;}
+  uint32_t l1aIndex() const {return n == 0 ? 0 : (n - 1) / 2;}
+
+  // BCID of window index i
+  uint32_t bcid(uint32_t i) const {
+    uint32_t b = first + i;
+    return b >= OrbitLength ? b - OrbitLength : b;
+  }
+  uint32_t firstBCID() const {return first;}
+  uint32_t lastBCID() const {return n == 0 ? first : bcid(n - 1);}
+
+  // BX relative to the L1A of window index i, and the window's BXVector range
+  int relativeBX(uint32_t i) const {return int(i) - int(l1aIndex());}
+  int firstBX() const {return -int(l1aIndex());}
+  int lastBX() const {return n == 0 ? 0 : int(n - 1 - l1aIndex());}
+
+  // BCIDs of the whole window in to bcids[nBX()]
+  void bcids(uint32_t *bcids) const {fillBCIDs(l1a, n, bcids);}
+
+  // Bulk conversions; both loops are branch free so the compiler can vectorize them
+  static void fillBCIDs(uint32_t l1aBCID, uint32_t nBX, uint32_t *bcids);
+  static void toRelative(const uint32_t *bcids, uint32_t nBCIDs, uint32_t l1aBCID, int *relative);
+
+private:
+
+  uint32_t l1a;
+  uint32_t n;
+  uint32_t first;
+
+};
+
+#endif
@@ -2,12 +2,14 @@
 #include <iomanip>
 #include <cstring>      // Needed for memset
 #include <sys/socket.h> // Needed for the socket functions
+#include <poll.h>
 #include <netdb.h>      // Needed for the socket functions
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 
 #include "CTP7Client.hh"
+#include "FrameCodec.hh"
 #include <climits>
 
 /*
@@ -16,7 +18,7 @@
  * June 2014
  */
 
-CTP7Client::CTP7Client(const char* serverHost, const char* serverPort, bool v) : verbose(v) {
+CTP7Client::CTP7Client(const char* serverHost, const char* serverPort, bool v) : verbose(v), encodedTransfer(false) {
 
   struct addrinfo host_info;       // The struct that getaddrinfo() fills up with data.
 
@@ -196,7 +198,7 @@ uint32_t CTP7Client::getValue(BufferType bufferType,
       if(sscanf(msg, "%x", &value) != 1) std::cerr << msg << std::endl;
     }
   }    
-  return true;
+  return value;
 }
 
 bool CTP7Client::getValues(BufferType bufferType,
@@ -209,6 +211,10 @@ bool CTP7Client::getValues(BufferType bufferType,
     return false;
   }
 
+  // Registers are read word by word; only link and DAQ data is worth encoding
+  if(encodedTransfer && numberOfValues >= 6 * FrameCodec::WordsPerFrame)
+    return getEncodedValues(bufferType, startAddressOffset, numberOfValues, buffer);
+
   sprintf(msg, "getValues(%x,%x,%x)", bufferType, startAddressOffset, numberOfValues);
 
   ssize_t bytes_received = getResult(msg, buffer, MSGLEN, numberOfValues*4, true);
@@ -226,6 +232,61 @@ bool CTP7Client::getValues(BufferType bufferType,
 
 }
 
+/*
+ * The server answers with the size in bytes of the FrameCodec stream,
+ * followed by the stream itself
+ */
+
+bool CTP7Client::getEncodedValues(BufferType bufferType,
+				  uint32_t startAddressOffset, 
+				  uint32_t numberOfValues, 
+				  uint32_t *buffer) {
+
+  if(!checkArgs(bufferType, startAddressOffset, numberOfValues)){
+    std::cout<<"Failed Check Args Step "<<std::endl; 
+    return false;
+  }
+
+  sprintf(msg, "getEncodedValues(%x,%x,%x)", bufferType, startAddressOffset, numberOfValues);
+
+  uint32_t nBytes = 0;
+  if(getResult(msg, &nBytes, MSGLEN, sizeof(nBytes), true) != sizeof(nBytes)) {
+    printConnectionError();
+    return false;
+  }
+
+  //A server without the command answers with something else; the stream
+  //is out of step after that, so drain it and go back to plain reads
+  if(nBytes > FrameCodec::maxEncodedSize(numberOfValues)) {
+    std::cerr << "CTP7Client::getEncodedValues() unexpected reply size " << nBytes
+	      << ", falling back to getValues" << std::endl;
+    drainReply();
+    encodedTransfer = false;
+    return false;
+  }
+
+  encoded.resize(nBytes);
+  if(nBytes != 0 && recv(socketfd, encoded.data(), nBytes, MSG_WAITALL) != (ssize_t) nBytes) {
+    drainReply();
+    return false;
+  }
+
+  return FrameCodec::decode(encoded.data(), nBytes, buffer, numberOfValues);
+}
+
+/*
+ * Read and drop whatever the server still sends, until it has been
+ * quiet for 100 ms, so the next command does not take it as its reply
+ */
+
+void CTP7Client::drainReply() {
+  char scratch[4096];
+  struct pollfd pfd;
+  pfd.fd = socketfd;
+  pfd.events = POLLIN;
+  while(poll(&pfd, 1, 100) > 0 && recv(socketfd, scratch, sizeof(scratch), 0) > 0);
+}
+
 bool CTP7Client::setValue(BufferType bufferType, 
 			  uint32_t addressOffset, 
 			  uint32_t value) {
@@ -361,7 +422,7 @@ bool CTP7Client::setCapturePoint(uint32_t capture_point){
   }
   return true;
 }
-  
+
 bool CTP7Client::setConstantPattern(BufferType bufferType, 
 				    uint32_t linkNumber, 
 				    uint32_t value) {
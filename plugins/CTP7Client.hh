@@ -14,6 +14,10 @@ public:
 
   void setVerbose(bool v) {verbose = v;}
 
+  // Bulk reads are sent FrameCodec encoded by the server; unusable until the
+  // CTP7 server implements the getEncodedValues command
+  void setEncodedTransfer(bool e) {encodedTransfer = e;}
+
   bool checkConnection();
 
   bool getConfiguration(std::string output);
@@ -52,6 +56,8 @@ public:
 
   bool getValues(BufferType bufferType, uint32_t startAddressOffset, uint32_t numberOfValues, uint32_t *buffer);
 
+  bool getEncodedValues(BufferType bufferType, uint32_t startAddressOffset, uint32_t numberOfValues, uint32_t *buffer);
+
   bool setValue(BufferType bufferType, uint32_t addressOffset, uint32_t value);
 
   bool setValues(BufferType bufferType, uint32_t startAddressOffset, uint32_t numberOfValues, uint32_t *buffer);
@@ -180,6 +186,9 @@ private:
 
   bool checkArgs(BufferType bufferType, uint32_t addressOffset = 0, uint32_t numberOfValues = 1);
 
+  // Discard the rest of a reply that cannot be used
+  void drainReply();
+
   struct addrinfo *host_info_list; // Pointer to the to the linked list of host_info's.
   int socketfd; // Socket file descriptor
 
@@ -192,6 +201,9 @@ private:
   
   bool verbose;
 
+  bool encodedTransfer;
+  std::vector<uint8_t> encoded;
+
   char msg[MSGLEN];
 
 };
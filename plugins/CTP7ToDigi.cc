@@ -23,6 +23,7 @@
 #include <iostream>
 #include <string>
 #include <sys/time.h>
+#include <future>
 using namespace std;
 
 // Framework stuff
@@ -31,6 +32,7 @@ using namespace std;
 #include "FWCore/Framework/interface/EDProducer.h"
 
 #include "FWCore/Framework/interface/Event.h"
+#include "FWCore/Framework/interface/Run.h"
 #include "FWCore/Framework/interface/MakerMacros.h"
 
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
@@ -46,12 +48,21 @@ using namespace std;
 #include "DataFormats/L1CaloTrigger/interface/L1CaloRegion.h"
 #include "DataFormats/L1CaloTrigger/interface/L1CaloRegionDetId.h"
 #include "DataFormats/L1CaloTrigger/interface/L1CaloCollections.h"
+#include "../src/L1CaloBXCollections.hh"
+#include "../src/RCTFrameErrors.hh"
 
 // Link Monitor Class
 
 #include "CTP7Tests/LinkMonitor/interface/LinkMonitor.h"
 #include "CTP7Tests/TimeMonitor/interface/TimeMonitor.h"
-#include "RunNumberFactory.hh"
+#include "CaptureMetadata.hh"
+#include "CrateLinkMap.hh"
+#include "PatternFileLoader.hh"
+#include "CaptureFile.hh"
+#include "DumpWriter.hh"
+#include "CaptureWaiter.hh"
+#include "RCTInfoDumper.hh"
+#include "DAQSpyDecoder.hh"
 
 // Scan in file
 
@@ -71,9 +82,12 @@ public:
 private:
   virtual void beginJob() override;
   virtual void produce(edm::Event&, const edm::EventSetup&) override;
-  int getLinkNumber(bool even, int crate, bool mp7Mapping);
-  bool scanInLink(uint32_t link, uint32_t tempBuffer[NIntsPerLink], unsigned int offset);
-  void printLinksToFile();
+  void unpackBX(uint32_t index, int16_t bx, L1CaloEmCollection &emCands, L1CaloRegionCollection &regions);
+  bool readBlock(uint32_t block);
+  bool ensureLoaded(uint32_t firstWord, uint32_t nWords);
+  void startPrefetch(uint32_t block);
+  bool waitForPrefetch();
+  void dumpCapture(uint32_t captureBCID);
   bool waitForCaptureSuccess();
   virtual void endJob() override;      
   virtual void beginRun(edm::Run const&, edm::EventSetup const&) override;
@@ -91,13 +105,50 @@ private:
   
   uint32_t buffer[NILinks][NIntsPerLink];
 
+  CaptureMetadata metadata;
+
+  CrateLinkMap linkMap;
+  bool discoverLinkMap;
+  std::string linkMapCacheDir;
+
   int NEventsPerCapture;
+  uint32_t captureBX;
   bool test;
   bool createLinkFile;
   bool mp7Mapping;
   bool doTimingScan;
+  bool bxVectorOutput;
+  uint32_t NBXPerEvent;
+
+
+  // Frame errors of the current capture, put in the event using its last BX
+  RCTFrameErrors captureErrors;
+
+  // Text dumps of the crates unpacked for one event in every infoDumpPrescale
+  RCTInfoDumper infoDumper;
+  bool dumpEvent;
+  uint32_t dumpEventNumber;
 
-  char fileName[40];
+  // Lazy readout transfers link data in blocks of readoutBlockBX as events reach them
+  bool lazyReadout;
+  uint32_t blockWords;
+  uint32_t nBlocks;
+  // One byte per block, so the prefetch thread can set its own flag
+  std::vector<uint8_t> blockLoaded;
+  std::future<bool> prefetch;
+  uint32_t prefetchBlock;
+
+  PatternFileLoader patternFile;
+
+  // Binary capture files: written in normal running, read back in test mode
+  std::string captureFile;
+  CaptureFile::Reader captureReader;
+  bool compressCaptureFile;
+
+  // Link text dumps and capture file records are written off the event loop
+  DumpWriter *dumpWriter;
+  CaptureWaiter captureWaiter;
+  bool asyncDump;
 
 };
 
@@ -107,8 +158,8 @@ private:
 
 const uint32_t NIntsPerFrame = 6;
 
-//Fill a vector to fill LinkMonitorCollection later
-typedef std::vector<uint32_t> LinkMonitorTmp;
+//Number of BXs that fit in one link capture buffer (1024/6)
+const uint32_t NBXPerCapture = NIntsPerLink / NIntsPerFrame;
 
 //
 // static data member definitions
@@ -124,27 +175,92 @@ CTP7ToDigi::CTP7ToDigi(const edm::ParameterSet& iConfig)
   ctp7Host = iConfig.getUntrackedParameter<std::string>("ctp7Host");
   ctp7Port = iConfig.getUntrackedParameter<std::string>("ctp7Port");
   NEventsPerCapture = iConfig.getUntrackedParameter<int>("NEventsPerCapture",170);
+  if(NEventsPerCapture < 1) NEventsPerCapture = 1;
+  if(NEventsPerCapture > (int) NBXPerCapture) NEventsPerCapture = NBXPerCapture;
+  captureBX = NEventsPerCapture;
   test = iConfig.getUntrackedParameter<bool>("test",false);
   createLinkFile = iConfig.getUntrackedParameter<bool>("createLinkFile",false);
   mp7Mapping = iConfig.getUntrackedParameter<bool>("mp7Mapping",false);
   testFile = iConfig.getUntrackedParameter<std::string>("testFile","testFile.txt");
   // Create CTP7Client to communicate with specified host/port 
-  ctp7Client = new CTP7Client(ctp7Host.c_str(), ctp7Port.c_str());
+  ctp7Client = 0;
+  if(!test)
+    ctp7Client = new CTP7Client(ctp7Host.c_str(), ctp7Port.c_str());
+  //Bulk reads arrive FrameCodec encoded, the CTP7 server has to support getEncodedValues
+  if(ctp7Client != 0)
+    ctp7Client->setEncodedTransfer(iConfig.getUntrackedParameter<bool>("encodedTransfer",false));
   doTimingScan = iConfig.getUntrackedParameter<bool>("doTimingScan",false);
-  //set test file name here, shoudl be added as an untrackedParamater
-  sprintf(fileName,testFile.c_str());
+  //Link to crate map is read from the CTP7 link IDs at beginRun, cached per firmware
+  discoverLinkMap = iConfig.getUntrackedParameter<bool>("discoverLinkMap",true);
+  linkMapCacheDir = iConfig.getUntrackedParameter<std::string>("linkMapCacheDir",".");
+  linkMap.setDefault(mp7Mapping);
+  //Unpacked crates are dumped as text: human, csv or jsonl, level 0 off, 1 crates, 2 crates and fiber words
+  infoDumper.setup(iConfig.getUntrackedParameter<std::string>("infoDumpFormat","human"),
+		   iConfig.getUntrackedParameter<int>("infoDumpLevel",0),
+		   iConfig.getUntrackedParameter<unsigned int>("infoDumpPrescale",1),
+		   iConfig.getUntrackedParameter<std::string>("infoDumpFile",""));
+  dumpEvent = false;
+  dumpEventNumber = 0;
+  //Pack a window of BXs in to each event using BXVector collections
+  bxVectorOutput = iConfig.getUntrackedParameter<bool>("bxVectorOutput",false);
+  int nBX = iConfig.getUntrackedParameter<int>("NBXPerEvent",1);
+  if(nBX < 1) nBX = 1;
+  if(nBX > (int) NBXPerCapture) nBX = NBXPerCapture;
+  NBXPerEvent = bxVectorOutput ? nBX : 1;
+
+  //Only transfer the BX blocks that events will consume, prefetching one block ahead
+  lazyReadout = iConfig.getUntrackedParameter<bool>("lazyReadout",false);
+  int blockBX = iConfig.getUntrackedParameter<int>("readoutBlockBX",10);
+  if(blockBX < 1) blockBX = 1;
+  if(blockBX > (int) NBXPerCapture) blockBX = NBXPerCapture;
+  blockWords = blockBX * NIntsPerFrame;
+  nBlocks = (NIntsPerLink + blockWords - 1) / blockWords;
+  blockLoaded.assign(nBlocks, false);
+  prefetchBlock = nBlocks;
+  captureFile = iConfig.getUntrackedParameter<std::string>("captureFile","");
+  compressCaptureFile = iConfig.getUntrackedParameter<bool>("compressCaptureFile",true);
+  if(lazyReadout && (createLinkFile || !captureFile.empty())) {
+    cout << "CTP7ToDigi: createLinkFile and captureFile need the full buffer, lazyReadout disabled" << endl;
+    lazyReadout = false;
+  }
+
+  if(test)
+    lazyReadout = false;
 
+  //Capture polls back off from 5 us up to captureMaxBackoffUs until captureTimeoutMs
+  captureWaiter.configure(5, iConfig.getUntrackedParameter<unsigned int>("captureMaxBackoffUs",1000),
+			  iConfig.getUntrackedParameter<unsigned int>("captureTimeoutMs",1000));
+
+  dumpWriter = 0;
+  asyncDump = iConfig.getUntrackedParameter<bool>("asyncDump",true);
+  if(createLinkFile || (!test && !captureFile.empty())) {
+    dumpWriter = new DumpWriter(NILinks, NIntsPerLink,
+				iConfig.getUntrackedParameter<int>("dumpQueueDepth",4),
+				iConfig.getUntrackedParameter<bool>("dumpDropWhenFull",false));
+    if(createLinkFile)
+      dumpWriter->setTextFile(DumpWriter::LinkText, "outputFile.txt");
+  }
 
   //register your products
-  produces<L1CaloEmCollection>();
-  produces<L1CaloRegionCollection>();
+  if(bxVectorOutput) {
+    produces<L1CaloEmCandBxCollection>();
+    produces<L1CaloRegionBxCollection>();
+  }
+  else {
+    produces<L1CaloEmCollection>();
+    produces<L1CaloRegionCollection>();
+  }
   produces<LinkMonitorCollection>();
   produces<TimeMonitorCollection>();
+  produces<RCTFrameErrors>();
 }
 
 
 CTP7ToDigi::~CTP7ToDigi()
 {
+  // The prefetch must not outlive the client it is using
+  waitForPrefetch();
+  delete dumpWriter;
   // Close CTP7Client connection
   if(ctp7Client != 0) delete ctp7Client;
 }
@@ -179,367 +295,307 @@ CTP7ToDigi::produce(edm::Event& iEvent, const edm::EventSetup& iSetup)
 
     cout<<"Capture number: "<<dec<<countCycles<<endl;
     index=0;
+    captureErrors.clear();
 
-  //  if(!test) {// normal mode
+    //A prefetch still in flight would race with the new capture on the connection
+    waitForPrefetch();
+    blockLoaded.assign(nBlocks, false);
 
-    if(!ctp7Client->checkConnection()){
-      cout<<"CTP7 Check Connection FAILED!!!! If you are trying ";
-      cout<<"to capture data from CTP7, think again!"<<endl;}
+    if(!test) {// normal mode
 
+      if(!ctp7Client->checkConnection()){
+        cout<<"CTP7 Check Connection FAILED!!!! If you are trying ";
+        cout<<"to capture data from CTP7, think again!"<<endl;}
 
-    uint32_t offsetCapture=0;
-    if(doTimingScan) offsetCapture=170*countCycles;
+      uint32_t offsetCapture=0;
+      if(doTimingScan) offsetCapture=170*countCycles;
 
 
-    ctp7Client->setCapturePoint(offsetCapture);
-    countCycles++;
+      ctp7Client->setCapturePoint(offsetCapture);
+      countCycles++;
 
-    ctp7Client->capture();
+      ctp7Client->capture();
 
-    if(!waitForCaptureSuccess())
-      cout<<"Capture Not Successful!!!"<<endl;
+      if(!waitForCaptureSuccess())
+	cout<<"Capture Not Successful!!!"<<endl;
 
+      //Run number, time and link status are shared by all events of the capture
+      if(!metadata.newCapture(ctp7Client))
+        cerr << "CTP7ToDigi::produce() Error reading link status from CTP7" << endl;
 
-      for(uint32_t link = 0; link < NILinks; link++) {
-	unsigned int addressOffset = link * NIntsPerLink * 4;
-	if(!ctp7Client->getValues(CTP7::inputBuffer,addressOffset,NIntsPerLink,buffer[link])){
-	  cerr << "CTP7ToDigi::produce() Error reading from CTP7" << endl;
-	}
+      if(!lazyReadout) {
+        for(uint32_t link = 0; link < NILinks; link++) {
+	  unsigned int addressOffset = link * NIntsPerLink * 4;
+	  if(!ctp7Client->getValues(CTP7::inputBuffer,addressOffset,NIntsPerLink,buffer[link])){
+	    cerr << "CTP7ToDigi::produce() Error reading from CTP7" << endl;
+	  }
+        }
       }
-/*
-
-   }
+    }
     else {// test mode
       cout <<"TESTING MODE"<<endl;
       if(mp7Mapping) cout<<"mp7Mapping"<<endl;
-      for(uint32_t link = 0; link < NILinks; link++) {
-	if(!scanInLink(link,buffer[link], offset)){
-	  cerr << "CTP7ToDigi::produce() Error reading from file: " << testFile << endl;
-	}
+      countCycles++;
+      bool status = true;
+      if(captureReader.captures() != 0) {
+	//Replay the captures of a .ctp7cap file in turn
+	uint32_t capture = (countCycles - 1) % captureReader.captures();
+	for(uint32_t link = 0; link < NILinks; link++)
+	  status = (captureReader.readBlock(capture, link, buffer[link], NIntsPerLink) == NIntsPerLink) && status;
+      }
+      else {
+	//The pattern file is parsed once and cached, later captures only copy it
+	status = patternFile.loadLinks(testFile, buffer, offset);
+      }
+      if(!status){
+	cerr << "CTP7ToDigi::produce() Error reading from file: " << testFile << endl;
       }
+      metadata.newCapture(0);
     }
 
-*/
-
-    if(createLinkFile)
-      printLinksToFile();
+    if(dumpWriter != 0)
+      dumpCapture(doTimingScan ? 170*(countCycles-1) : 0);
   }  
 
   // Take six ints at a time from even and odd fibers, assumed to be neighboring
   // channels to make rctInfo buffer, and from that make rctEMCands and rctRegions
 
-  RCTInfoFactory rctInfoFactory;
-
-  std::auto_ptr<L1CaloEmCollection> rctEMCands(new L1CaloEmCollection);
-  std::auto_ptr<L1CaloRegionCollection> rctRegions(new L1CaloRegionCollection);
-  //LinkMonitorCollection Final Output Collection
+  //LinkMonitorCollection Final Output Collection, from the status snapshot of this capture
   std::auto_ptr<LinkMonitorCollection> rctLinkMonitor(new LinkMonitorCollection);
-  //Grab the link vector by first filling a different class-less type
-  std::auto_ptr<LinkMonitorTmp> rctLinksTmp(new LinkMonitorTmp);
-  //Fill the rctLinksTmp 
-  ctp7Client->dumpStatus(*rctLinksTmp);
- 
-  for (uint32_t i = 0; i < rctLinksTmp->size() ; i++){
-  rctLinkMonitor->push_back(LinkMonitor(rctLinksTmp->at(i)));
+  for (uint32_t i = 0; i < metadata.linkStatus.size() ; i++){
+  rctLinkMonitor->push_back(LinkMonitor(metadata.linkStatus[i]));
   }
 
+  //run number, "ddmm" and "hhmmss" of the capture go in time collection 
   std::auto_ptr<TimeMonitorCollection> rctTime(new TimeMonitorCollection);
-  //run number goes in time collection 
-  RunNumberFactory runNumberFactory;
-  int32_t run = runNumberFactory.RunSummary();
-  std::cout<<"Run: "<<run<<std::endl;
-  //get date in int form "ddmm"-- if first day starts with zero, will be 3 numbers long
-  char date[80];
-  rctInfoFactory.timeStampCharDate(date);
-  uint16_t ddmm = atol(date);
-
-  //get time in long int form "hhmmss"-- if first hour starts with zero(s) will be 5(4) numbers long.
-  char clock[80];
-  rctInfoFactory.timeStampCharTime(clock);
-  uint32_t hms = atol(clock);
-  //Fill the time collection
-  rctTime->push_back(TimeMonitor(ddmm,hms,run));
-
- for(uint32_t link = 0; link < NILinks; link+=2){
-    //for(uint32_t link = 0; link < NILinks/2; link++) {
-    vector <uint32_t> evenFiberData;
-    vector <uint32_t> oddFiberData;
-    vector <RCTInfo> rctInfo;
-
-    cout<<endl<<dec<<"Crate Number? --> "<<link/2<<endl;
- 
-    int CTP7link;
-    for(uint32_t i = 0; i < 6; i++) {
-      //Order for filling the links is 0 to 18, however, the links are not ordered in the CTP7
-      //getLinkNumber method provides a temporary mapping; a long term getLinkID and match
-      //Needs to be implemented (currently in place in the CTP7 Unpacker)
-    
-      CTP7link = getLinkNumber(true,link/2,mp7Mapping);
-      evenFiberData.push_back(buffer[CTP7link][index+i]);
-      CTP7link = getLinkNumber(false,link/2,mp7Mapping);
-      oddFiberData.push_back(buffer[CTP7link][index+i]);
+  rctTime->push_back(TimeMonitor(metadata.ddmm,metadata.hms,metadata.run));
+
+  //The last window of a capture may be shorter than NBXPerEvent
+  uint32_t nBX = NBXPerEvent;
+  if(loopEvents + nBX > captureBX) nBX = captureBX - loopEvents;
+
+  if(lazyReadout && !ensureLoaded(index, nBX * NIntsPerFrame))
+    cerr << "CTP7ToDigi::produce() Error reading from CTP7" << endl;
+
+  dumpEvent = infoDumper.sample();
+  dumpEventNumber = eventNumber;
+
+  if(bxVectorOutput) {
+    std::auto_ptr<L1CaloEmCandBxCollection> rctEMCands(new L1CaloEmCandBxCollection);
+    std::auto_ptr<L1CaloRegionBxCollection> rctRegions(new L1CaloRegionBxCollection);
+    rctEMCands->setBXRange(0, nBX - 1);
+    rctRegions->setBXRange(0, nBX - 1);
+
+    L1CaloEmCollection emCands;
+    L1CaloRegionCollection regions;
+    emCands.reserve(NRCTCrates * DAQSpyDecoder::EmCandsPerCrate);
+    regions.reserve(NRCTCrates * DAQSpyDecoder::RegionsPerCrate);
+    for(uint32_t iBX = 0; iBX < nBX; iBX++) {
+      emCands.clear();
+      regions.clear();
+      unpackBX(index + iBX * NIntsPerFrame, iBX, emCands, regions);
+      //push_back(bx, obj) shifts the offsets of every later BX per object; size the BX once, then set
+      rctEMCands->resize(iBX, emCands.size());
+      for(uint32_t i = 0; i < emCands.size(); i++)
+	rctEMCands->set(iBX, i, emCands[i]);
+      rctRegions->resize(iBX, regions.size());
+      for(uint32_t i = 0; i < regions.size(); i++)
+	rctRegions->set(iBX, i, regions[i]);
     }
 
-    cout<<"Print evenFiberData : ";
-    for (uint32_t i=0; i<evenFiberData.size(); i++){           cout<<hex<<evenFiberData.at(i)<<",";    }
-    cout<<endl<<"Print oddFiberData :";
-    for (uint32_t i=0; i<evenFiberData.size(); i++){          cout<<hex<<oddFiberData.at(i)<<",";     }
-    cout<<endl;
+    iEvent.put(rctEMCands);
+    iEvent.put(rctRegions);
+  }
+  else {
+    std::auto_ptr<L1CaloEmCollection> rctEMCands(new L1CaloEmCollection);
+    std::auto_ptr<L1CaloRegionCollection> rctRegions(new L1CaloRegionCollection);
 
-    cout<<"RCT Info size:" << rctInfo.size()<<endl;
+    unpackBX(index, 0, *rctEMCands, *rctRegions);
 
-    rctInfoFactory.produce(evenFiberData, oddFiberData, rctInfo);
-    rctInfoFactory.printRCTInfo(rctInfo);
-    for(int j = 0; j < 4; j++) {
-      rctEMCands->push_back(L1CaloEmCand(rctInfo[0].neRank[j], rctInfo[0].neRegn[j], rctInfo[0].neCard[j], link/2, false));
-    }
-    for(int j = 0; j < 4; j++) {
-      rctEMCands->push_back(L1CaloEmCand(rctInfo[0].ieRank[j], rctInfo[0].ieRegn[j], rctInfo[0].ieCard[j], link/2, true));
-    }
-    for(int j = 0; j < 7; j++) {
-      for(int k = 0; k < 2; k++) {
-	bool o = (((rctInfo[0].oBits >> (j * 2 + k)) & 0x1) == 0x1);
-	bool t = (((rctInfo[0].tBits >> (j * 2 + k)) & 0x1) == 0x1);
-	bool m = (((rctInfo[0].mBits >> (j * 2 + k)) & 0x1) == 0x1);
-	bool q = (((rctInfo[0].qBits >> (j * 2 + k)) & 0x1) == 0x1);
-	rctRegions->push_back(L1CaloRegion(rctInfo[0].rgnEt[j][k], o, t, m, q, link/2, j, k));
-      }
-    }
-    for(int j = 0; j < 2; j++) {
-      for(int k = 0; k < 4; k++) {
-        // bool fineGrain = hfFineGrainBits.at(hfRgn);
-        bool fg=(((rctInfo[0].hfQBits>> (j * 4 + k)) & 0x1)  == 0x1); 
-	rctRegions->push_back(L1CaloRegion(rctInfo[0].hfEt[j][k], fg, link/2, (j * 4 +  k)));
-      }
-    }
+    iEvent.put(rctEMCands);
+    iEvent.put(rctRegions);
   }
 
+  if(dumpEvent)
+    infoDumper.flush();
 
-  iEvent.put(rctEMCands);
-  iEvent.put(rctRegions);
   iEvent.put(rctLinkMonitor);
   iEvent.put(rctTime);
 
-  cout <<dec<< "CTP7ToDigi::produce() " << index << endl;
+  //Each capture's errors go out once; the other events of the capture get an empty RCTFrameErrors
+  std::auto_ptr<RCTFrameErrors> frameErrors(new RCTFrameErrors);
+  if(loopEvents + nBX >= captureBX)
+    *frameErrors = captureErrors;
+  iEvent.put(frameErrors);
 
-  index += NIntsPerFrame;
+  cout <<dec<< "CTP7ToDigi::produce() " << index << endl;
 
-  // index and "loopEvents" cannot be the same. loopEvents needs to increase by one, while index is used in evenFiberData and is increased by NIntsPerFrame 
-  // this part needs debugging!
+  index += NIntsPerFrame * nBX;
 
-  uint32_t MINIMUM= 169;//NEventsPerCapture ;
+  // index and "loopEvents" cannot be the same. loopEvents counts the BXs consumed from the capture, while index is used in evenFiberData and is increased by NIntsPerFrame 
+  // A new capture starts once captureBX BXs, NEventsPerCapture clamped to the capture, are used
 
-  if(loopEvents>=MINIMUM) {loopEvents=0;}
-  else loopEvents++; 
+  if(loopEvents + nBX >= captureBX) {loopEvents=0;}
+  else loopEvents += nBX; 
 
   eventNumber++;
    
 }
 
-int CTP7ToDigi::getLinkNumber(bool even, int crate, bool mp7Mapping){
-  if(!mp7Mapping){
-  //even is even and odd is odd
-  if(even){
-    if(crate==0)return  15;//LinkID 15: a   
-    if(crate==1)return  18;//LinkID 18: 10a 
-    if(crate==2)return  20;//LinkID 20: 20a 
-    if(crate==3)return  12;//LinkID 12: 30a 
-    if(crate==4)return  13;//LinkID 13: 40a 
-    if(crate==5)return  17;//LinkID 17: 50a 
-    if(crate==6)return   2;//LinkID 2: 60a  
-    if(crate==7)return   5;//LinkID 5: 70a  
-    if(crate==8)return  10;//LinkID 10: 80a 
-    if(crate==9)return   0;//LinkID 0: 90a  
-    if(crate==10)return  1;//LinkID 1: a0a  
-    if(crate==11)return  6;//LinkID 6: b0a  
-    if(crate==12)return 27;//LinkID 27: c0a 
-    if(crate==13)return 30;//LinkID 30: d0a 
-    if(crate==14)return 32;//LinkID 32: e0a 
-    if(crate==15)return 24;//LinkID 24: f0a 
-    if(crate==16)return 25;//LinkID 25: 100a
-    if(crate==17)return 29;//LinkID 29: 110a
-    else{
-      std::cout<<"Failed to find odd crate; since we don't check the linkIDs from CTP7 this must be a software bug! (check with Isobel)"<<std::endl;
-      return 0;}
-  }
-  else{
-    if(crate==0)return  16;//LinkID 16: b   
-    if(crate==1)return  19;//LinkID 19: 10b 
-    if(crate==2)return  21;//LinkID 21: 20b 
-    if(crate==3)return  14;//LinkID 14: 30b 
-    if(crate==4)return  23;//LinkID 23: 40b 
-    if(crate==5)return  22;//LinkID 22: 50b 
-    if(crate==6)return   4;//LinkID 4: 60b  
-    if(crate==7)return   7;//LinkID 7: 70b  
-    if(crate==8)return   8;//LinkID 8: 80b   
-    if(crate==9)return   3;//LinkID 3: 90b  
-    if(crate==10)return  9;//LinkID 9: a0b  
-    if(crate==11)return 11;//LinkID 11: b0b 
-    if(crate==12)return 28;//LinkID 28: c0b 
-    if(crate==13)return 31;//LinkID 31: d0b 
-    if(crate==14)return 33;//LinkID 33: e0b 
-    if(crate==15)return 26;//LinkID 26: f0b 
-    if(crate==16)return 35;//LinkID 35: 100b
-    if(crate==17)return 34;//LinkID 34: 110b
-    else{
-      std::cout<<"Failed to find odd crate; since we don't check the linkIDs from CTP7 this must be a software bug! (check with Isobel, as it is likely her fault)"<<std::endl;
-      return 0;
-    }
-  }
-  }
-  else{
-    if(even){
-      if(crate==0)return  0;//LinkID 15: a   
-      if(crate==1)return  8;//LinkID 18: 10a 
-      if(crate==2)return  16;//LinkID 20: 20a 
-      if(crate==3)return  24;//LinkID 12: 30a 
-      if(crate==4)return  32;//LinkID 13: 40a 
-      if(crate==5)return  28;//LinkID 17: 50a 
-      if(crate==6)return  20;//LinkID 2: 60a  
-      if(crate==7)return  12;//LinkID 5: 70a  
-      if(crate==8)return  4;//LinkID 10: 80a 
-      if(crate==9)return  2;//LinkID 0: 90a  
-      if(crate==10)return 10;//LinkID 1: a0a  
-      if(crate==11)return 18;//LinkID 6: b0a  
-      if(crate==12)return 26;//LinkID 27: c0a 
-      if(crate==13)return 34;//LinkID 30: d0a 
-      if(crate==14)return 30;//LinkID 32: e0a 
-      if(crate==15)return 22;//LinkID 24: f0a 
-      if(crate==16)return 14;//LinkID 25: 100a
-      if(crate==17)return 6;//LinkID 29: 110a
-      else{
-      std::cout<<"Failed to find even crate; since we don't check the linkIDs from CTP7 this must be a software bug! (check with Isobel)"<<std::endl;
-      return 0;}
+/*
+ * Decode one BX, starting at word index in the link buffers, for all crates
+ * and append the resulting candidates and regions to the collections.
+ * They are written in place from the fiber words, with room made for every
+ * crate up front; an RCTInfo is only unpacked for the crates being dumped.
+ */
+
+void CTP7ToDigi::unpackBX(uint32_t index, int16_t bx, L1CaloEmCollection &emCands, L1CaloRegionCollection &regions){
+
+  RCTInfoFactory rctInfoFactory;
+  rctInfoFactory.setErrorStats(&captureErrors);
+
+  uint32_t emBase = emCands.size();
+  uint32_t regionBase = regions.size();
+  emCands.resize(emBase + NRCTCrates * DAQSpyDecoder::EmCandsPerCrate);
+  regions.resize(regionBase + NRCTCrates * DAQSpyDecoder::RegionsPerCrate);
+  uint32_t nGood = 0;
+
+  for(uint32_t link = 0; link < NILinks; link+=2){
+    //for(uint32_t link = 0; link < NILinks/2; link++) {
+    //Order for filling the links is 0 to 18, however, the links are not ordered in the CTP7
+    //linkMap provides the mapping, discovered from the CTP7 link IDs at beginRun
+    //The frames are read in place from the link buffers
+    int evenLink = linkMap.getLinkNumber(true,link/2);
+    int oddLink = linkMap.getLinkNumber(false,link/2);
+    if(evenLink < 0 || oddLink < 0)
+      continue;
+    const uint32_t *evenFiberData = &buffer[evenLink][index];
+    const uint32_t *oddFiberData = &buffer[oddLink][index];
+    rctInfoFactory.setLinks(evenLink, oddLink, index / NIntsPerFrame);
+
+    RCTInfoPacked frames;
+    unsigned char frameStatus;
+    rctInfoFactory.produce(RCTInfoFactory::FiberSpan(evenFiberData, NIntsPerFrame),
+			   RCTInfoFactory::FiberSpan(oddFiberData, NIntsPerFrame),
+			   &frames, &frameStatus, 1);
+    if(frameStatus == RCTInfoFactory::FRAME_BAD_BX_BYTE) {
+      //Frames that did not decode are dumped on their own
+      if(dumpEvent)
+	infoDumper.record(dumpEventNumber, index / NIntsPerFrame, link/2, 0, evenFiberData, oddFiberData);
+      continue;
     }
-    else{
-      if(crate==0)return  1;//LinkID 16: b   
-      if(crate==1)return  9;//LinkID 19: 10b 
-      if(crate==2)return  17;//LinkID 21: 20b 
-      if(crate==3)return  25;//LinkID 14: 30b 
-      if(crate==4)return  33;//LinkID 23: 40b 
-      if(crate==5)return  29;//LinkID 22: 50b 
-      if(crate==6)return  21;//LinkID 4: 60b  
-      if(crate==7)return  13;//LinkID 7: 70b  
-      if(crate==8)return  5;//LinkID 8: 80b   
-      if(crate==9)return  3;//LinkID 3: 90b  
-      if(crate==10)return 11;//LinkID 9: a0b  
-      if(crate==11)return 19;//LinkID 11: b0b 
-      if(crate==12)return 27;//LinkID 28: c0b 
-      if(crate==13)return 35;//LinkID 31: d0b 
-      if(crate==14)return 31;//LinkID 33: e0b 
-      if(crate==15)return 23;//LinkID 26: f0b 
-      if(crate==16)return 15;//LinkID 35: 100b
-      if(crate==17)return 7;//LinkID 34: 110b
-      else{
-	std::cout<<"Failed to find odd crate; since we don't check the linkIDs from CTP7 this must be a software bug! (check with Isobel, as it is likely her fault)"<<std::endl;
-	return 0;
-      }
+    if(dumpEvent) {
+      RCTInfo rctInfo;
+      frames.unpack(rctInfo, link/2);
+      infoDumper.record(dumpEventNumber, index / NIntsPerFrame, link/2, &rctInfo, evenFiberData, oddFiberData);
+      infoDumper.endGroup();
     }
+    DAQSpyDecoder::emitCrate(frames, link/2, bx,
+			     &emCands[emBase + nGood * DAQSpyDecoder::EmCandsPerCrate],
+			     &regions[regionBase + nGood * DAQSpyDecoder::RegionsPerCrate]);
+    nGood++;
   }
+
+  emCands.resize(emBase + nGood * DAQSpyDecoder::EmCandsPerCrate);
+  regions.resize(regionBase + nGood * DAQSpyDecoder::RegionsPerCrate);
 }
+
 /*
- * This reads in a file of form testFile.txt (see test directory for example)
- * and outputs a dump of the same form that would be received by a CTP7 Capture
+ * Lazy readout: link buffers are transferred in blocks of blockWords,
+ * only when the event index reaches them. As soon as an event enters a
+ * block the following one is prefetched, so it is in flight while the
+ * events of this block are decoded and written out. At most one block is
+ * in flight; it is always waited for before the client is used again,
+ * as the connection carries one request at a time.
  */
- 
-bool CTP7ToDigi::scanInLink(uint32_t link, uint32_t tempBuffer[NIntsPerLink], unsigned int offset){
 
-  FILE *fptr = fopen(fileName, "r");
-  std::cout << "reading file "<<fileName<<std::endl;
-  if(fptr == NULL) {
-    cout<<"Error: Could not open emulator input file "<<endl;
-    return false;
-  } 
-
-  uint32_t tempBuffer2[NIntsPerLink];
-  char line[100];
-  char searchTerm[100];
-  int ret = 0; 
-
-  char wordLink[20];
-  sprintf(wordLink,"link");
-  sprintf(searchTerm,"%u",(unsigned int) link);
-
-  unsigned int j = 0, i = 0;
-  unsigned int tInt = 0;
-  bool foundlink = false;
-
-  while (1) {
-    ret = fscanf(fptr, "%s", line);
-    j++;
-
-    if(ret == EOF)
-      break;
-    
-    if(i == NIntsPerLink)
-      break;
-    
-    if( foundlink && i < NIntsPerLink){
-      //std::cout << line <<" " << std::endl;
-      //if(i%6==0)
-      //std::cout<<endl;
-      sscanf(line, "%x", &tInt);
-      tempBuffer2[i] = tInt;
-      i++;
-    }
+bool CTP7ToDigi::readBlock(uint32_t block){
+  uint32_t firstWord = block * blockWords;
+  uint32_t nWords = blockWords;
+  if(firstWord + nWords > NIntsPerLink) nWords = NIntsPerLink - firstWord;
 
-    if(strcmp(line,wordLink)==0){
-      ret = fscanf(fptr, "%s", line);
-      if (strcmp(line,searchTerm)==0){
-	foundlink = true;
-	//std::cout<<"FOUND LINK!!!!!! "<< searchTerm<< " "<< line<< " At line "<< j <<std::endl;
-      }
-    }
+  for(uint32_t link = 0; link < NILinks; link++) {
+    unsigned int addressOffset = (link * NIntsPerLink + firstWord) * 4;
+    if(!ctp7Client->getValues(CTP7::inputBuffer,addressOffset,nWords,&buffer[link][firstWord]))
+      return false;
   }
-
-  for(unsigned int j = 0; j < NIntsPerLink-offset; j++)
-    tempBuffer[j] = tempBuffer2[j+offset];
-
-  fclose(fptr);
+  blockLoaded[block] = true;
   return true;
-  
 }
 
-void CTP7ToDigi::printLinksToFile(){
-  char outputFile[40];
-  sprintf(outputFile,"outputFile.txt");
-  FILE *fptr = fopen(outputFile, "w");
-  for(unsigned int j = 0; j < NILinks; j++){
-    fprintf( fptr, "\nlink %i\n", j );
-    for(unsigned int i = 0; i< NIntsPerLink; i++){
-      fprintf( fptr, "%x ", buffer[j][i] );
-      if(i%6==5)
-	fputs("\n",fptr);
-    }
+bool CTP7ToDigi::waitForPrefetch(){
+  prefetchBlock = nBlocks;
+  if(!prefetch.valid())
+    return true;
+  return prefetch.get();
+}
+
+bool CTP7ToDigi::ensureLoaded(uint32_t firstWord, uint32_t nWords){
+  uint32_t firstBlock = firstWord / blockWords;
+  uint32_t lastBlock = (firstWord + nWords - 1) / blockWords;
+
+  //Only wait for the prefetch if this event needs its block, or needs the connection
+  bool waitNeeded = false;
+  for(uint32_t block = firstBlock; block <= lastBlock; block++) {
+    if(block == prefetchBlock || !blockLoaded[block])
+      waitNeeded = true;
+  }
+  //A failed prefetch leaves its block unloaded, so it is simply read again below
+  if(waitNeeded)
+    waitForPrefetch();
+
+  bool status = true;
+  for(uint32_t block = firstBlock; block <= lastBlock; block++) {
+    if(!blockLoaded[block] && !readBlock(block))
+      status = false;
   }
 
-  fclose(fptr);
+  startPrefetch(lastBlock + 1);
+  return status;
+}
 
+void CTP7ToDigi::startPrefetch(uint32_t block){
+  //Blocks past the last BX this capture uses are never read
+  if(block >= nBlocks || block * blockWords >= captureBX * NIntsPerFrame ||
+     block == prefetchBlock || blockLoaded[block])
+    return;
+  waitForPrefetch();
+  prefetchBlock = block;
+  prefetch = std::async(std::launch::async, &CTP7ToDigi::readBlock, this, block);
 }
 
 /*
- * Check CTP7 Capture Status to see if Capture was Successful
- * After 5 attempts return false. TCP/IP communication takes 
+ * Copy the capture in to a pooled buffer and queue it for the dump writer
  */
 
-bool CTP7ToDigi::waitForCaptureSuccess(){
-
-  int nAttempts = 0;
-  CTP7::CaptureStatus captureStatusTemp;
-  CTP7::CaptureStatus *captureStatus;
-  captureStatus = &captureStatusTemp;
+void CTP7ToDigi::dumpCapture(uint32_t captureBCID){
+  int slot = dumpWriter->acquire();
+  if(slot < 0)
+    return;
+  memcpy(dumpWriter->data(slot), buffer, sizeof(buffer));
+  dumpWriter->submit(slot, CaptureFile::makeHeader(CaptureFile::LinkPayload, ctp7Host, metadata.gitHash,
+						   metadata.run, captureBCID));
+}
 
-  while(nAttempts<5){
+/*
+ * Poll the CTP7 capture status, backing off between polls, until the
+ * capture is done or captureTimeoutMs has passed.
+ */
 
-    ctp7Client->getCaptureStatus(captureStatus);
+bool CTP7ToDigi::waitForCaptureSuccess(){
 
-    if(*captureStatus == CTP7::Done)
-      return true;
+  CTP7::CaptureStatus captureStatus;
+  CaptureWaiter::Result result = captureWaiter.wait([this, &captureStatus]() {
+      if(!ctp7Client->getCaptureStatus(&captureStatus))
+	return -1;
+      return captureStatus == CTP7::Done ? 1 : 0;
+    });
 
-    nAttempts++;
+  if(result != CaptureWaiter::Done) {
+    cerr << "CTP7ToDigi::waitForCaptureSuccess() Capture " << CaptureWaiter::resultName(result) << endl;
+    return false;
   }
-
-  return false;
+  return true;
 }
 
 // ------------ method called once each job just before starting event loop  ------------
@@ -547,20 +603,40 @@ void
 CTP7ToDigi::beginJob()
 {
   cout << "CTP7ToDigi::beginJob()" << endl;
+  if(test && testFile.size() > 8 && testFile.compare(testFile.size() - 8, 8, ".ctp7cap") == 0)
+    captureReader.open(testFile);
+  if(dumpWriter != 0) {
+    if(!test && !captureFile.empty())
+      dumpWriter->openCaptureFile(captureFile, compressCaptureFile);
+    if(asyncDump)
+      dumpWriter->start();
+  }
 }
 
 // ------------ method called once each job just after ending the event loop  ------------
 void 
 CTP7ToDigi::endJob() {
   cout << "CTP7ToDigi::endJob()" << endl;
+  if(dumpWriter != 0) {
+    dumpWriter->stop();
+    dumpWriter->printStats("CTP7ToDigi");
+  }
+  captureWaiter.printHistogram("CTP7ToDigi");
+  infoDumper.flush();
 }
 
 // ------------ method called when starting to processes a run  ------------
 
 void
-CTP7ToDigi::beginRun(edm::Run const&, edm::EventSetup const&)
+CTP7ToDigi::beginRun(edm::Run const& iRun, edm::EventSetup const&)
 {
   cout << "CTP7ToDigi::beginRun()" << endl;
+  metadata.setRun(iRun.run());
+  if(!test && !metadata.readFirmware(ctp7Client))
+    cout << "CTP7ToDigi::beginRun() Could not read firmware GITHASH" << endl;
+
+  if(!test && discoverLinkMap && !linkMap.discover(ctp7Client, linkMapCacheDir))
+    cout << "CTP7ToDigi::beginRun() Link map discovery incomplete, crates without links are left out" << endl;
 }
 
  
@@ -600,6 +676,25 @@ CTP7ToDigi::fillDescriptions(edm::ConfigurationDescriptions& descriptions) {
   desc.addUntracked<std::string>("ctp7Host", "localhost")->setComment("CTP7 TCP/IP host name");
   desc.addUntracked<std::string>("ctp7Port", "5555")->setComment("CTP7 TCP/IP port name");
   desc.addUntracked<bool>("test", false)->setComment("Test or normal running?");
+  desc.addUntracked<bool>("discoverLinkMap", true)->setComment("Build the link to crate map from the CTP7 link IDs");
+  desc.addUntracked<std::string>("linkMapCacheDir", ".")->setComment("Directory for link maps cached per firmware GITHASH, empty to disable");
+  desc.addUntracked<std::string>("captureFile", "")->setComment("Binary .ctp7cap file to append every capture to, empty to disable");
+  desc.addUntracked<bool>("compressCaptureFile", true)->setComment("Store capture file blocks FrameCodec encoded and identical blocks once");
+  desc.addUntracked<bool>("encodedTransfer", false)->setComment("Request FrameCodec encoded bulk reads from the CTP7 server. Unusable until the server implements the getEncodedValues command");
+  desc.addUntracked<bool>("asyncDump", true)->setComment("Write link dumps and capture file records on a background thread");
+  desc.addUntracked<int>("dumpQueueDepth", 4)->setComment("Number of pooled capture buffers queued for the dump writer");
+  desc.addUntracked<bool>("dumpDropWhenFull", false)->setComment("Skip dumps instead of waiting when the dump writer falls behind");
+  desc.addUntracked<unsigned int>("captureTimeoutMs", 1000)->setComment("Give up waiting for a CTP7 capture after this many ms");
+  desc.addUntracked<unsigned int>("captureMaxBackoffUs", 1000)->setComment("Longest pause between CTP7 capture status polls, in us");
+  desc.addUntracked<bool>("lazyReadout", false)->setComment("Transfer link data in blocks as events reach them");
+  desc.addUntracked<int>("readoutBlockBX", 10)->setComment("Number of BXs per lazy readout block");
+  desc.addUntracked<int>("NEventsPerCapture", 170)->setComment("Number of BXs used from each capture (max 170)");
+  desc.addUntracked<std::string>("infoDumpFormat", "human")->setComment("Text dump format of the unpacked crates: human, csv or jsonl");
+  desc.addUntracked<int>("infoDumpLevel", 0)->setComment("0 no dump, 1 unpacked crates, 2 unpacked crates and fiber words");
+  desc.addUntracked<unsigned int>("infoDumpPrescale", 1)->setComment("Dump one event in this many");
+  desc.addUntracked<std::string>("infoDumpFile", "")->setComment("File to dump to, empty for stdout");
+  desc.addUntracked<bool>("bxVectorOutput", false)->setComment("Put BXVector collections holding NBXPerEvent BXs in each event");
+  desc.addUntracked<int>("NBXPerEvent", 1)->setComment("Number of BXs per event in bxVectorOutput mode (max 170)");
 }
 
 //define this as a plug-in
@@ -0,0 +1,285 @@
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "CableDecoder.hh"
+
+/*
+ * Word a of each BX is the first 80 MHz cycle, word b the second.
+ *
+ * Each cable is a struct giving the fields it carries as a function of
+ * (a, b), written once as a template so the same expressions run on
+ * plain words and on GCC vectors of four words. decodeCable runs them 8
+ * BXs at a time and narrows the results in to the 16 bit columns; only
+ * a tail of fewer than 8 BXs is decoded word by word.
+ *
+ * A column is written by the first cable carrying it and ORed in by the
+ * later ones (bit k of orMask), so cables are decoded in order 1 to 6.
+ */
+
+typedef uint32_t Words4 __attribute__((vector_size(16)));
+typedef uint16_t Halves8 __attribute__((vector_size(16)));
+
+#if defined(__clang__)
+static inline Words4 evenWords(Words4 x, Words4 y) {return __builtin_shufflevector(x, y, 0, 2, 4, 6);}
+static inline Words4 oddWords(Words4 x, Words4 y) {return __builtin_shufflevector(x, y, 1, 3, 5, 7);}
+static inline Halves8 narrow(Words4 lo, Words4 hi) {
+  return __builtin_shufflevector((Halves8) lo, (Halves8) hi, 0, 2, 4, 6, 8, 10, 12, 14);
+}
+#else
+static inline Words4 evenWords(Words4 x, Words4 y) {return __builtin_shuffle(x, y, (Words4) {0, 2, 4, 6});}
+static inline Words4 oddWords(Words4 x, Words4 y) {return __builtin_shuffle(x, y, (Words4) {1, 3, 5, 7});}
+// Low halves of the words of lo then hi; every field fits in 16 bits
+static inline Halves8 narrow(Words4 lo, Words4 hi) {
+  return __builtin_shuffle((Halves8) lo, (Halves8) hi, (Halves8) {0, 2, 4, 6, 8, 10, 12, 14});
+}
+#endif
+
+template <typename Cable>
+static void decodeCable(const uint32_t *words, uint32_t nBX, uint16_t *store, uint32_t stride)
+{
+  const uint32_t NFields = Cable::NFields;
+  uint16_t *cols[NFields];
+  for(uint32_t k = 0; k < NFields; k++)
+    cols[k] = store + Cable::column(k) * stride;
+
+  uint32_t i = 0;
+  for(; i + 8 <= nBX; i += 8) {
+    Words4 x[4];
+    memcpy(x, words + 2 * i, sizeof(x));
+    Words4 lo[NFields], hi[NFields];
+    Cable::fields(evenWords(x[0], x[1]), oddWords(x[0], x[1]), lo);
+    Cable::fields(evenWords(x[2], x[3]), oddWords(x[2], x[3]), hi);
+    for(uint32_t k = 0; k < NFields; k++) {
+      Halves8 v = narrow(lo[k], hi[k]);
+      if(Cable::orMask & (1u << k)) {
+	Halves8 old;
+	memcpy(&old, cols[k] + i, sizeof(old));
+	v |= old;
+      }
+      memcpy(cols[k] + i, &v, sizeof(v));
+    }
+  }
+  for(; i < nBX; i++) {
+    uint32_t f[NFields];
+    Cable::fields(words[2 * i], words[2 * i + 1], f);
+    for(uint32_t k = 0; k < NFields; k++)
+      cols[k][i] = (Cable::orMask & (1u << k)) ? (cols[k][i] | f[k]) : f[k];
+  }
+}
+
+// Cables 1 and 2: four EM candidates as rank (6), region (1), card (3), then
+// 8 (iso) or 6 (non-iso) of the quiet and MIP bits, swapped by half a BX
+template <bool Iso>
+struct EMCable {
+  static const uint32_t NFields = 15;
+  static const uint32_t orMask = Iso ? 0 : (0x3 << 12);
+  static uint32_t column(uint32_t k) {
+    const uint32_t base = Iso ? CableDecoder::IeRank : CableDecoder::NeRank;
+    if(k < 12) return base + k;
+    if(k == 12) return CableDecoder::QBits;
+    if(k == 13) return CableDecoder::MBits;
+    return CableDecoder::BC0 + (Iso ? 0 : 1);
+  }
+  template <typename T>
+  static void fields(T a, T b, T *f) {
+    f[0] = a & 0x3F;
+    f[1] = (a >> 10) & 0x3F;
+    f[2] = b & 0x3F;
+    f[3] = (b >> 10) & 0x3F;
+    f[4] = (a >> 6) & 0x1;
+    f[5] = (a >> 16) & 0x1;
+    f[6] = (b >> 6) & 0x1;
+    f[7] = (b >> 16) & 0x1;
+    f[8] = (a >> 7) & 0x7;
+    f[9] = (a >> 17) & 0x7;
+    f[10] = (b >> 7) & 0x7;
+    f[11] = (b >> 17) & 0x7;
+    if(Iso) {
+      f[12] = (a >> 20) & 0xFF;
+      f[13] = (b >> 20) & 0xFF;
+    }
+    else {
+      f[12] = ((a >> 20) & 0x3F) << 8;
+      f[13] = ((b >> 20) & 0x3F) << 8;
+    }
+    f[14] = (a >> 31) | ((b >> 31) << 1);
+  }
+};
+
+// Cable 3: HF ETs, bit 0 of the first four is on cable 4
+struct HFCable {
+  static const uint32_t NFields = 9;
+  static const uint32_t orMask = 0;
+  static uint32_t column(uint32_t k) {return k < 8 ? CableDecoder::HfEt + k : CableDecoder::BC0 + 2;}
+  template <typename T>
+  static void fields(T a, T b, T *f) {
+    f[0] = (a << 1) & 0xFE;
+    f[1] = ((a >> 7) << 1) & 0xFE;
+    f[2] = (b << 1) & 0xFE;
+    f[3] = ((b >> 7) << 1) & 0xFE;
+    f[4] = (a >> 14) & 0xFF;
+    f[5] = (a >> 22) & 0xFF;
+    f[6] = (b >> 14) & 0xFF;
+    f[7] = (b >> 22) & 0xFF;
+    f[8] = (a >> 31) | ((b >> 31) << 1);
+  }
+};
+
+// Cable 4: regions 5 and 6, HF quality bits and HF ET bit 0
+struct Region56Cable {
+  static const uint32_t NFields = 12;
+  static const uint32_t orMask = 0xF << 7;
+  static uint32_t column(uint32_t k) {
+    static const uint32_t columns[NFields] = {
+      CableDecoder::RgnEt + 10, CableDecoder::RgnEt + 11, CableDecoder::RgnEt + 12, CableDecoder::RgnEt + 13,
+      CableDecoder::OBits, CableDecoder::TBits, CableDecoder::HfQBits,
+      CableDecoder::HfEt + 0, CableDecoder::HfEt + 1, CableDecoder::HfEt + 2, CableDecoder::HfEt + 3,
+      CableDecoder::BC0 + 3};
+    return columns[k];
+  }
+  template <typename T>
+  static void fields(T a, T b, T *f) {
+    f[0] = a & 0x3FF;
+    f[1] = b & 0x3FF;
+    f[2] = (a >> 12) & 0x3FF;
+    f[3] = (b >> 12) & 0x3FF;
+    f[4] = (((a >> 10) & 0x1) << 10) | (((b >> 10) & 0x1) << 11) | (((a >> 22) & 0x1) << 12) | (((b >> 22) & 0x1) << 13);
+    f[5] = (((a >> 11) & 0x1) << 10) | (((b >> 11) & 0x1) << 11) | (((a >> 23) & 0x1) << 12) | (((b >> 23) & 0x1) << 13);
+    f[6] = ((a | b) >> 24) & 0xF;
+    f[7] = (a >> 28) & 0x1;
+    f[8] = (a >> 29) & 0x1;
+    f[9] = (b >> 28) & 0x1;
+    f[10] = (b >> 29) & 0x1;
+    f[11] = (a >> 31) | ((b >> 31) << 1);
+  }
+};
+
+// Cable 5: regions 0 and 1, bottom six bits of region 2
+struct Region01Cable {
+  static const uint32_t NFields = 9;
+  static const uint32_t orMask = 0x3 << 6;
+  static uint32_t column(uint32_t k) {
+    static const uint32_t columns[NFields] = {
+      CableDecoder::RgnEt + 0, CableDecoder::RgnEt + 1, CableDecoder::RgnEt + 2,
+      CableDecoder::RgnEt + 3, CableDecoder::RgnEt + 4, CableDecoder::RgnEt + 5,
+      CableDecoder::OBits, CableDecoder::TBits, CableDecoder::BC0 + 4};
+    return columns[k];
+  }
+  template <typename T>
+  static void fields(T a, T b, T *f) {
+    f[0] = a & 0x3FF;
+    f[1] = b & 0x3FF;
+    f[2] = (a >> 12) & 0x3FF;
+    f[3] = (b >> 12) & 0x3FF;
+    f[4] = (a >> 24) & 0x3F;
+    f[5] = (b >> 24) & 0x3F;
+    f[6] = ((a >> 10) & 0x1) | (((b >> 10) & 0x1) << 1) | (((a >> 22) & 0x1) << 2) | (((b >> 22) & 0x1) << 3);
+    f[7] = ((a >> 11) & 0x1) | (((b >> 11) & 0x1) << 1) | (((a >> 23) & 0x1) << 2) | (((b >> 23) & 0x1) << 3);
+    f[8] = (a >> 31) | ((b >> 31) << 1);
+  }
+};
+
+// Cable 6: top four bits of region 2, regions 3 and 4
+struct Region34Cable {
+  static const uint32_t NFields = 9;
+  static const uint32_t orMask = 0x3 | (0x3 << 6);
+  static uint32_t column(uint32_t k) {
+    static const uint32_t columns[NFields] = {
+      CableDecoder::RgnEt + 4, CableDecoder::RgnEt + 5, CableDecoder::RgnEt + 6,
+      CableDecoder::RgnEt + 7, CableDecoder::RgnEt + 8, CableDecoder::RgnEt + 9,
+      CableDecoder::OBits, CableDecoder::TBits, CableDecoder::BC0 + 5};
+    return columns[k];
+  }
+  template <typename T>
+  static void fields(T a, T b, T *f) {
+    f[0] = (a << 6) & 0x3C0;
+    f[1] = (b << 6) & 0x3C0;
+    f[2] = (a >> 6) & 0x3FF;
+    f[3] = (b >> 6) & 0x3FF;
+    f[4] = (a >> 18) & 0x3FF;
+    f[5] = (b >> 18) & 0x3FF;
+    f[6] = (((a >> 4) & 0x1) << 4) | (((b >> 4) & 0x1) << 5) | (((a >> 16) & 0x1) << 6) |
+      (((b >> 16) & 0x1) << 7) | (((a >> 28) & 0x1) << 8) | (((b >> 28) & 0x1) << 9);
+    f[7] = (((a >> 5) & 0x1) << 4) | (((b >> 5) & 0x1) << 5) | (((a >> 17) & 0x1) << 6) |
+      (((b >> 17) & 0x1) << 7) | (((a >> 29) & 0x1) << 8) | (((b >> 29) & 0x1) << 9);
+    f[8] = (a >> 31) | ((b >> 31) << 1);
+  }
+};
+
+CableDecoder::Status CableDecoder::decode(const CableSpan cables[NCables])
+{
+  for(uint32_t c = 0; c < NCables; c++)
+    if(cables[c].words == 0 && cables[c].nWords != 0)
+      return MissingCable;
+  for(uint32_t c = 1; c < NCables; c++)
+    if(cables[c].nWords != cables[0].nWords)
+      return LengthMismatch;
+  if(cables[0].nWords % WordsPerBX != 0)
+    return OddLength;
+
+  //Columns are padded apart so that long dumps do not put them all in the same cache sets
+  n = cables[0].nWords / WordsPerBX;
+  stride = ((n + 7) & ~7u) + 32;
+  store.resize(NColumns * stride);
+
+  decodeCable< EMCable<true> >(cables[0].words, n, store.data(), stride);
+  decodeCable< EMCable<false> >(cables[1].words, n, store.data(), stride);
+  decodeCable<HFCable>(cables[2].words, n, store.data(), stride);
+  decodeCable<Region56Cable>(cables[3].words, n, store.data(), stride);
+  decodeCable<Region01Cable>(cables[4].words, n, store.data(), stride);
+  decodeCable<Region34Cable>(cables[5].words, n, store.data(), stride);
+
+  return Ok;
+}
+
+CableDecoder::Status CableDecoder::decode(const std::vector< std::vector<unsigned int> > &cables)
+{
+  if(cables.size() != NCables)
+    return MissingCable;
+  CableSpan spans[NCables];
+  for(uint32_t c = 0; c < NCables; c++)
+    spans[c] = CableSpan(cables[c]);
+  return decode(spans);
+}
+
+const char *CableDecoder::statusName(Status status)
+{
+  switch(status) {
+  case Ok: return "Ok";
+  case MissingCable: return "MissingCable";
+  case LengthMismatch: return "LengthMismatch";
+  case OddLength: return "OddLength";
+  }
+  return "Unknown";
+}
+
+void CableDecoder::unpack(uint32_t iBX, RCTInfo &rctInfo) const
+{
+  rctInfo = RCTInfo();
+  for(uint32_t j = 0; j < 4; j++) {
+    rctInfo.ieRank[j] = ieRank(j)[iBX];
+    rctInfo.ieRegn[j] = ieRegn(j)[iBX];
+    rctInfo.ieCard[j] = ieCard(j)[iBX];
+    rctInfo.neRank[j] = neRank(j)[iBX];
+    rctInfo.neRegn[j] = neRegn(j)[iBX];
+    rctInfo.neCard[j] = neCard(j)[iBX];
+  }
+  rctInfo.mBits = mBits()[iBX];
+  rctInfo.qBits = qBits()[iBX];
+  for(uint32_t i = 0; i < 2; i++)
+    for(uint32_t j = 0; j < 4; j++)
+      rctInfo.hfEt[i][j] = hfEt(i, j)[iBX];
+  rctInfo.hfQBits = hfQBits()[iBX];
+  for(uint32_t card = 0; card < 7; card++)
+    for(uint32_t region = 0; region < 2; region++)
+      rctInfo.rgnEt[card][region] = rgnEt(card, region)[iBX];
+  rctInfo.oBits = oBits()[iBX];
+  rctInfo.tBits = tBits()[iBX];
+  rctInfo.c1BC0 = bc0(1)[iBX];
+  rctInfo.c2BC0 = bc0(2)[iBX];
+  rctInfo.c3BC0 = bc0(3)[iBX];
+  rctInfo.c4BC0 = bc0(4)[iBX];
+  rctInfo.c5BC0 = bc0(5)[iBX];
+  rctInfo.c6BC0 = bc0(6)[iBX];
+}
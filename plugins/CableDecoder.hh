@@ -0,0 +1,101 @@
+#ifndef CableDecoder_hh
+#define CableDecoder_hh
+
+#include <stdint.h>
+#include <vector>
+
+#include "RCTInfo.hh"
+
+/*
+ * Bulk decoder for oRSC capture RAM dumps of the six RCT crate cables.
+ *
+ * Each cable carries two 32 bit words per BX (the two 80 MHz cycles).
+ * The six cables are checked up front, then decoded one cable at a time,
+ * eight BXs per step with GCC vector types.
+ * Results are kept as one column per field (structure of arrays), so a
+ * timing study can scan e.g. the BC0 marks of a cable over the whole dump.
+ *
+ * Field values are those of the scalar
+ * RCTInfoFactory::produce(cableData, rctInfo), which is kept as the
+ * reference; unpack() gives them back as RCTInfo for comparison.
+ */
+
+class CableDecoder {
+
+public:
+
+  static const uint32_t NCables = 6;
+  static const uint32_t WordsPerBX = 2;
+
+  enum Status {Ok = 0, MissingCable, LengthMismatch, OddLength};
+
+  // Columns, in the order of the RCTInfo members; indexed ones take consecutive columns
+  enum Column {
+    IeRank = 0, IeRegn = 4, IeCard = 8,
+    NeRank = 12, NeRegn = 16, NeCard = 20,
+    MBits = 24, QBits = 25,
+    HfEt = 26,          // [2][4]
+    HfQBits = 34,
+    RgnEt = 35,         // [7][2]
+    OBits = 49, TBits = 50,
+    BC0 = 51,           // cables 1-6
+    NColumns = 57
+  };
+
+  // The capture RAM words of one cable
+  struct CableSpan {
+    CableSpan() : words(0), nWords(0) {;}
+    CableSpan(const uint32_t *w, uint32_t n) : words(w), nWords(n) {;}
+    CableSpan(const std::vector<unsigned int> &w) : words(w.data()), nWords(w.size()) {;}
+    const uint32_t *words;
+    uint32_t nWords;
+  };
+
+  CableDecoder() : n(0), stride(0) {;}
+  ~CableDecoder() {;}
+
+  // Decode cables 1-6 (iso EM, non-iso EM, HF, then the region cables 4-6);
+  // nothing is decoded unless all six are there with the same even length
+  Status decode(const CableSpan cables[NCables]);
+  Status decode(const std::vector< std::vector<unsigned int> > &cables);
+
+  static const char *statusName(Status status);
+
+  uint32_t nBX() const {return n;}
+
+  // Column c for BXs 0 to nBX() - 1
+  const uint16_t *column(uint32_t c) const {return store.data() + c * stride;}
+
+  const uint16_t *ieRank(uint32_t j) const {return column(IeRank + j);}
+  const uint16_t *ieRegn(uint32_t j) const {return column(IeRegn + j);}
+  const uint16_t *ieCard(uint32_t j) const {return column(IeCard + j);}
+  const uint16_t *neRank(uint32_t j) const {return column(NeRank + j);}
+  const uint16_t *neRegn(uint32_t j) const {return column(NeRegn + j);}
+  const uint16_t *neCard(uint32_t j) const {return column(NeCard + j);}
+  const uint16_t *mBits() const {return column(MBits);}
+  const uint16_t *qBits() const {return column(QBits);}
+  const uint16_t *hfEt(uint32_t i, uint32_t j) const {return column(HfEt + i * 4 + j);}
+  const uint16_t *hfQBits() const {return column(HfQBits);}
+  const uint16_t *rgnEt(uint32_t card, uint32_t region) const {return column(RgnEt + card * 2 + region);}
+  const uint16_t *oBits() const {return column(OBits);}
+  const uint16_t *tBits() const {return column(TBits);}
+  // BC0 marks of cable 1-6
+  const uint16_t *bc0(uint32_t cable) const {return column(BC0 + cable - 1);}
+
+  // BX iBX as the scalar decoder fills it
+  void unpack(uint32_t iBX, RCTInfo &rctInfo) const;
+
+private:
+
+  CableDecoder(const CableDecoder&);
+  const CableDecoder& operator=(const CableDecoder&);
+
+  uint32_t n;
+  uint32_t stride;
+
+  // NColumns columns stride BXs apart, reused between dumps
+  std::vector<uint16_t> store;
+
+};
+
+#endif
@@ -0,0 +1,295 @@
+#include <iostream>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <algorithm>
+
+#include "CaptureFile.hh"
+#include "FrameCodec.hh"
+
+namespace CaptureFile {
+
+  static const char FileMagic[8] = {'C', 'T', 'P', '7', 'C', 'A', 'P', '\0'};
+
+  static uint32_t hashWords(const uint32_t *words, uint32_t nWords)
+  {
+    uint32_t hash = 2166136261u;
+    for(uint32_t i = 0; i < nWords; i++)
+      hash = (hash ^ words[i]) * 16777619u;
+    return hash;
+  }
+
+  RecordHeader makeHeader(PayloadType payloadType, const std::string &board,
+			  uint32_t gitHash, int32_t run, uint32_t captureBCID)
+  {
+    RecordHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = RecordMagic;
+    header.payloadType = payloadType;
+    strncpy(header.board, board.c_str(), sizeof(header.board) - 1);
+    header.gitHash = gitHash;
+    header.run = run;
+    header.captureBCID = captureBCID;
+    struct timeval now;
+    gettimeofday(&now, 0);
+    header.timeSec = now.tv_sec;
+    header.timeUSec = now.tv_usec;
+    return header;
+  }
+
+  bool Writer::open(const std::string &fileName)
+  {
+    close();
+    fptr = fopen(fileName.c_str(), "wb");
+    if(fptr == 0) {
+      std::cerr << "CaptureFile::Writer::open() could not create " << fileName << std::endl;
+      return false;
+    }
+    FileHeader fileHeader;
+    memcpy(fileHeader.magic, FileMagic, sizeof(FileMagic));
+    fileHeader.version = Version;
+    fileHeader.reserved = 0;
+    nCaptures = 0;
+    index.clear();
+    return fwrite(&fileHeader, sizeof(fileHeader), 1, fptr) == 1;
+  }
+
+  bool Writer::writeCapture(const RecordHeader &header, const uint32_t *ids,
+			    const uint32_t * const *blocks, const uint32_t *nWords)
+  {
+    if(fptr == 0)
+      return false;
+
+    if(fwrite(&header, sizeof(header), 1, fptr) != 1)
+      return false;
+
+    for(uint32_t i = 0; i < header.nBlocks; i++) {
+      IndexEntry entry;
+      entry.offset = ftello(fptr);
+      entry.capture = nCaptures;
+      entry.id = ids[i];
+      entry.payloadType = header.payloadType;
+      entry.nWords = nWords[i];
+
+      BlockHeader blockHeader;
+      blockHeader.id = ids[i];
+      blockHeader.nWords = nWords[i];
+      blockHeader.encoding = RawWords;
+      blockHeader.nBytes = nWords[i] * sizeof(uint32_t);
+      const void *payload = blocks[i];
+
+      if(compress) {
+	hashes.resize(header.nBlocks);
+	hashes[i] = hashWords(blocks[i], nWords[i]);
+	uint32_t j = 0;
+	while(j < i && (hashes[j] != hashes[i] || nWords[j] != nWords[i] ||
+			memcmp(blocks[j], blocks[i], nWords[i] * sizeof(uint32_t)) != 0))
+	  j++;
+	if(j < i) {
+	  blockHeader.encoding = DuplicateBlock;
+	  blockHeader.nBytes = sizeof(uint32_t);
+	  payload = &ids[j];
+	}
+	else {
+	  coded.clear();
+	  if(FrameCodec::encode(blocks[i], nWords[i], coded) < blockHeader.nBytes) {
+	    blockHeader.encoding = FrameCoded;
+	    blockHeader.nBytes = coded.size();
+	    payload = coded.data();
+	  }
+	}
+      }
+
+      if(fwrite(&blockHeader, sizeof(blockHeader), 1, fptr) != 1 ||
+	 fwrite(payload, 1, blockHeader.nBytes, fptr) != blockHeader.nBytes) {
+	std::cerr << "CaptureFile::Writer::writeCapture() write failed" << std::endl;
+	return false;
+      }
+      index.push_back(entry);
+    }
+
+    nCaptures++;
+    return true;
+  }
+
+  bool Writer::close()
+  {
+    if(fptr == 0)
+      return true;
+
+    Footer footer;
+    footer.indexOffset = ftello(fptr);
+    footer.nEntries = index.size();
+    footer.magic = IndexMagic;
+    bool status = (index.empty() || fwrite(index.data(), sizeof(IndexEntry), index.size(), fptr) == index.size());
+    status = status && fwrite(&footer, sizeof(footer), 1, fptr) == 1;
+    fclose(fptr);
+    fptr = 0;
+    return status;
+  }
+
+  bool Reader::open(const std::string &fileName)
+  {
+    close();
+    fptr = fopen(fileName.c_str(), "rb");
+    if(fptr == 0) {
+      std::cout << "Error: Could not open capture file " << fileName << std::endl;
+      return false;
+    }
+
+    FileHeader fileHeader;
+    if(fread(&fileHeader, sizeof(fileHeader), 1, fptr) != 1 ||
+       memcmp(fileHeader.magic, FileMagic, sizeof(FileMagic)) != 0 ||
+       fileHeader.version != Version) {
+      std::cout << "Error: " << fileName << " is not a CTP7 capture file" << std::endl;
+      close();
+      return false;
+    }
+
+    if(readIndex() || scan())
+      return true;
+
+    close();
+    return false;
+  }
+
+  void Reader::close()
+  {
+    if(fptr != 0) fclose(fptr);
+    fptr = 0;
+    headers.clear();
+    index.clear();
+  }
+
+  /*
+   * Index present: read it, then the record headers it points back to
+   */
+
+  bool Reader::readIndex()
+  {
+    Footer footer;
+    if(fseeko(fptr, -(off_t) sizeof(footer), SEEK_END) != 0 ||
+       fread(&footer, sizeof(footer), 1, fptr) != 1 ||
+       footer.magic != IndexMagic)
+      return false;
+
+    index.resize(footer.nEntries);
+    if(fseeko(fptr, footer.indexOffset, SEEK_SET) != 0 ||
+       (footer.nEntries != 0 && fread(index.data(), sizeof(IndexEntry), footer.nEntries, fptr) != footer.nEntries)) {
+      index.clear();
+      return false;
+    }
+
+    // The record header sits just before the first block of each capture
+    for(uint32_t i = 0; i < index.size(); i++) {
+      if(index[i].capture != headers.size())
+	continue;
+      RecordHeader header;
+      if(fseeko(fptr, index[i].offset - sizeof(RecordHeader), SEEK_SET) != 0 ||
+	 fread(&header, sizeof(header), 1, fptr) != 1 || header.magic != RecordMagic) {
+	index.clear();
+	headers.clear();
+	return false;
+      }
+      headers.push_back(header);
+    }
+    return true;
+  }
+
+  /*
+   * No index (writer did not finish): walk the records, keeping complete ones
+   */
+
+  bool Reader::scan()
+  {
+    index.clear();
+    headers.clear();
+    if(fseeko(fptr, sizeof(FileHeader), SEEK_SET) != 0)
+      return false;
+
+    RecordHeader header;
+    while(fread(&header, sizeof(header), 1, fptr) == 1 && header.magic == RecordMagic) {
+      std::vector<IndexEntry> entries;
+      for(uint32_t i = 0; i < header.nBlocks; i++) {
+	IndexEntry entry;
+	entry.offset = ftello(fptr);
+	BlockHeader blockHeader;
+	if(fread(&blockHeader, sizeof(blockHeader), 1, fptr) != 1 ||
+	   fseeko(fptr, blockHeader.nBytes, SEEK_CUR) != 0)
+	  return !headers.empty();
+	entry.capture = headers.size();
+	entry.id = blockHeader.id;
+	entry.payloadType = header.payloadType;
+	entry.nWords = blockHeader.nWords;
+	entries.push_back(entry);
+      }
+      index.insert(index.end(), entries.begin(), entries.end());
+      headers.push_back(header);
+    }
+    return !headers.empty();
+  }
+
+  static bool captureLess(const IndexEntry &entry, uint32_t capture) {return entry.capture < capture;}
+
+  uint32_t Reader::readBlock(uint32_t capture, uint32_t id, uint32_t *buffer, uint32_t maxWords)
+  {
+    // Entries are in capture order; a capture holds at most a few dozen blocks
+    std::vector<IndexEntry>::const_iterator first = std::lower_bound(index.begin(), index.end(), capture, captureLess);
+    for(uint32_t i = first - index.begin(); i < index.size() && index[i].capture == capture; i++) {
+      if(index[i].id == id)
+	return readEntry(index[i], buffer, maxWords);
+    }
+    return 0;
+  }
+
+  uint32_t Reader::readEntry(const IndexEntry &entry, uint32_t *buffer, uint32_t maxWords)
+  {
+    BlockHeader blockHeader;
+    if(fseeko(fptr, entry.offset, SEEK_SET) != 0 ||
+       fread(&blockHeader, sizeof(blockHeader), 1, fptr) != 1)
+      return 0;
+
+    uint32_t nWords = blockHeader.nWords;
+    if(nWords > maxWords) nWords = maxWords;
+
+    switch(blockHeader.encoding) {
+    case RawWords:
+      if(fread(buffer, sizeof(uint32_t), nWords, fptr) != nWords)
+	return 0;
+      return nWords;
+    case FrameCoded: {
+      coded.resize(blockHeader.nBytes);
+      if(fread(coded.data(), 1, coded.size(), fptr) != coded.size())
+	return 0;
+      // The stream only decodes whole, so a short read goes through the scratch buffer
+      uint32_t *out = buffer;
+      if(nWords < blockHeader.nWords) {
+	words.resize(blockHeader.nWords);
+	out = words.data();
+      }
+      if(!FrameCodec::decode(coded.data(), coded.size(), out, blockHeader.nWords))
+	return 0;
+      if(out != buffer)
+	memcpy(buffer, out, nWords * sizeof(uint32_t));
+      return nWords;
+    }
+    case DuplicateBlock: {
+      // Only a block written before this one may be referenced, so a chain always ends
+      uint32_t source;
+      if(fread(&source, sizeof(source), 1, fptr) != 1)
+	return 0;
+      std::vector<IndexEntry>::const_iterator i = std::lower_bound(index.begin(), index.end(), entry.capture, captureLess);
+      for(; i != index.end() && i->capture == entry.capture; ++i) {
+	if(i->id == source && i->offset < entry.offset)
+	  return readEntry(*i, buffer, maxWords);
+      }
+      return 0;
+    }
+    default:
+      std::cout << "Error: unknown capture file block encoding " << blockHeader.encoding << std::endl;
+      return 0;
+    }
+  }
+
+}
@@ -0,0 +1,155 @@
+#ifndef CaptureFile_hh
+#define CaptureFile_hh
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+/*
+ * Binary .ctp7cap container for CTP7 link and DAQ captures.
+ *
+ * File layout (little endian):
+ *   FileHeader
+ *   for each capture: RecordHeader, then nBlocks x (BlockHeader + payload)
+ *   IndexEntry for every block, then Footer
+ *
+ * The trailing index gives random access to any capture and link. A file
+ * whose writer did not close it has no index and is scanned sequentially.
+ * With compression on, blocks repeating an earlier block of the capture
+ * are stored as references and the rest with FrameCodec when it is smaller.
+ */
+
+namespace CaptureFile {
+
+  enum PayloadType {
+    LinkPayload = 0,
+    DAQPayload = 1
+  };
+
+  // Block payload encodings
+  enum Encoding {
+    RawWords = 0,             // nWords 32-bit words
+    FrameCoded = 1,           // FrameCodec stream
+    DuplicateBlock = 2        // one word: id of an identical block earlier in the capture
+  };
+
+  struct FileHeader {
+    char magic[8];            // "CTP7CAP\0"
+    uint32_t version;
+    uint32_t reserved;
+  };
+
+  struct RecordHeader {
+    uint32_t magic;           // RecordMagic
+    uint32_t payloadType;
+    char board[32];
+    uint32_t gitHash;
+    int32_t run;
+    uint32_t captureBCID;
+    uint32_t timeSec;
+    uint32_t timeUSec;
+    uint32_t nBlocks;
+  };
+
+  struct BlockHeader {
+    uint32_t id;              // link number, or 0 for the DAQ buffer
+    uint32_t nWords;
+    uint32_t encoding;
+    uint32_t nBytes;          // payload size in the file
+  };
+
+  struct IndexEntry {
+    uint64_t offset;          // file offset of the BlockHeader
+    uint32_t capture;
+    uint32_t id;
+    uint32_t payloadType;
+    uint32_t nWords;
+  };
+
+  struct Footer {
+    uint64_t indexOffset;
+    uint32_t nEntries;
+    uint32_t magic;           // IndexMagic
+  };
+
+  const uint32_t Version = 1;
+  const uint32_t RecordMagic = 0x43455243; // "CREC"
+  const uint32_t IndexMagic = 0x58444943;  // "CIDX"
+
+  class Writer {
+
+  public:
+
+    Writer() : fptr(0), nCaptures(0), compress(false) {;}
+    ~Writer() {close();}
+
+    bool open(const std::string &fileName);
+    bool isOpen() const {return fptr != 0;}
+
+    void setCompression(bool c) {compress = c;}
+
+    // Appends one capture of nBlocks blocks; ids[i] names blocks[i] of nWords[i] words
+    bool writeCapture(const RecordHeader &header, const uint32_t *ids,
+		      const uint32_t * const *blocks, const uint32_t *nWords);
+
+    // Writes the index and footer
+    bool close();
+
+  private:
+
+    Writer(const Writer&);
+    const Writer& operator=(const Writer&);
+
+    FILE *fptr;
+    uint32_t nCaptures;
+    std::vector<IndexEntry> index;
+
+    bool compress;
+    std::vector<uint32_t> hashes;
+    std::vector<uint8_t> coded;
+
+  };
+
+  class Reader {
+
+  public:
+
+    Reader() : fptr(0) {;}
+    ~Reader() {close();}
+
+    bool open(const std::string &fileName);
+    void close();
+
+    uint32_t captures() const {return headers.size();}
+    const RecordHeader &header(uint32_t capture) const {return headers[capture];}
+
+    // Reads block id of a capture in to buffer; returns the number of words read
+    uint32_t readBlock(uint32_t capture, uint32_t id, uint32_t *buffer, uint32_t maxWords);
+
+  private:
+
+    Reader(const Reader&);
+    const Reader& operator=(const Reader&);
+
+    bool readIndex();
+    bool scan();
+    uint32_t readEntry(const IndexEntry &entry, uint32_t *buffer, uint32_t maxWords);
+
+    FILE *fptr;
+    std::vector<RecordHeader> headers;
+    std::vector<IndexEntry> index;
+
+    // Scratch space for decoding compressed blocks
+    std::vector<uint8_t> coded;
+    std::vector<uint32_t> words;
+
+  };
+
+  // Header filled with the capture time and the given board name
+  RecordHeader makeHeader(PayloadType payloadType, const std::string &board,
+			  uint32_t gitHash, int32_t run, uint32_t captureBCID);
+
+}
+
+#endif
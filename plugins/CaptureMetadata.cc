@@ -0,0 +1,54 @@
+#include <iostream>
+#include <stdint.h>
+#include <time.h>
+
+#include "CTP7Client.hh"
+#include "RunNumberFactory.hh"
+#include "CaptureMetadata.hh"
+
+/*
+ * The EmptySource used for CTP7 captures always reports run 1, in which case
+ * the run number is taken from RunSummary.html -- once per run, not per event
+ */
+
+void CaptureMetadata::setRun(int edmRun)
+{
+  run = edmRun;
+  if(edmRun <= 1) {
+    RunNumberFactory runNumberFactory;
+    int summaryRun = runNumberFactory.RunSummary();
+    if(summaryRun >= 0)
+      run = summaryRun;
+  }
+  std::cout << "Run: " << run << std::endl;
+}
+
+bool CaptureMetadata::readFirmware(CTP7Client *ctp7Client)
+{
+  CTP7::MiscRegisters miscRegisters;
+  if(!ctp7Client->getMiscRegisters(&miscRegisters))
+    return false;
+  gitHash = miscRegisters.GITHASH_CODE_REG;
+  return true;
+}
+
+bool CaptureMetadata::newCapture(CTP7Client *ctp7Client)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  monotonicNs = (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+
+  struct tm timeinfo;
+  time(&wallClock);
+  localtime_r(&wallClock, &timeinfo);
+  ddmm = timeinfo.tm_mday * 100 + (timeinfo.tm_mon + 1);
+  hms  = timeinfo.tm_hour * 10000 + timeinfo.tm_min * 100 + timeinfo.tm_sec;
+
+  nCaptures++;
+
+  linkStatus.clear();
+  if(ctp7Client == 0)
+    return true;
+
+  return ctp7Client->dumpStatus(linkStatus);
+}
@@ -0,0 +1,51 @@
+#ifndef CaptureMetadata_hh
+#define CaptureMetadata_hh
+
+#include <stdint.h>
+#include <time.h>
+#include <vector>
+
+class CTP7Client;
+
+/*
+ * Information shared by all events made from one CTP7 capture:
+ * the run number (resolved once per run), one timestamp per capture
+ * and a snapshot of the link status registers taken at capture time.
+ * Events reference this instead of recomputing it.
+ */
+
+class CaptureMetadata {
+
+public:
+
+  CaptureMetadata() : run(-1), gitHash(0), ddmm(0), hms(0), wallClock(0), monotonicNs(0), nCaptures(0) {;}
+  ~CaptureMetadata() {;}
+
+  // Resolve the run number once per run; EmptySource runs fall back to RunSummary.html
+  void setRun(int edmRun);
+
+  // Read the firmware GITHASH once per run
+  bool readFirmware(CTP7Client *ctp7Client);
+
+  // Stamp the capture and snapshot the link status (ctp7Client may be 0 in test mode)
+  bool newCapture(CTP7Client *ctp7Client);
+
+  int32_t run;
+  uint32_t gitHash;
+
+  // Wall clock time of the capture as "ddmm" and "hhmmss" integers for TimeMonitor
+  uint16_t ddmm;
+  uint32_t hms;
+  time_t wallClock;
+
+  // Monotonic capture time in ns, for intervals between captures
+  uint64_t monotonicNs;
+
+  uint32_t nCaptures;
+
+  // LINK_STATUS_REG for each input link
+  std::vector<uint32_t> linkStatus;
+
+};
+
+#endif
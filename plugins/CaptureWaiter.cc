@@ -0,0 +1,103 @@
+#include <iostream>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "CaptureWaiter.hh"
+
+using namespace std;
+
+static uint64_t monotonicUs()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return uint64_t(now.tv_sec) * 1000000ULL + now.tv_nsec / 1000;
+}
+
+CaptureWaiter::CaptureWaiter(uint32_t initialDelayUs, uint32_t maxDelayUs, uint32_t timeoutMs) :
+  cancelled(false), nTimeouts(0), nReadErrors(0), nPolls(0), maxUs(0)
+{
+  configure(initialDelayUs, maxDelayUs, timeoutMs);
+  for(uint32_t i = 0; i < NBins; i++)
+    bins[i] = 0;
+}
+
+void CaptureWaiter::configure(uint32_t initialDelayUs, uint32_t maxDelayUs, uint32_t timeoutMs)
+{
+  initialDelay = initialDelayUs > 0 ? initialDelayUs : 1;
+  maxDelay = maxDelayUs > initialDelay ? maxDelayUs : initialDelay;
+  timeout = uint64_t(timeoutMs) * 1000;
+}
+
+const char *CaptureWaiter::resultName(Result result)
+{
+  switch(result) {
+  case Done: return "done";
+  case TimedOut: return "timed out";
+  case Cancelled: return "cancelled";
+  case ReadError: return "read error";
+  }
+  return "unknown";
+}
+
+CaptureWaiter::Result CaptureWaiter::wait(const Poll &poll)
+{
+  const uint32_t maxReadErrors = 3;
+
+  uint64_t start = monotonicUs();
+  uint64_t deadline = start + timeout;
+  uint32_t delay = initialDelay;
+  uint32_t errorsInRow = 0;
+
+  while(true) {
+    if(cancelled)
+      return Cancelled;
+
+    nPolls++;
+    int status = poll();
+    uint64_t now = monotonicUs();
+
+    if(status > 0) {
+      uint64_t waited = now - start;
+      uint32_t bin = 0;
+      while(bin < NBins - 1 && (uint64_t(1) << bin) <= waited)
+	bin++;
+      bins[bin]++;
+      if(waited > maxUs)
+	maxUs = waited;
+      return Done;
+    }
+
+    if(status < 0) {
+      nReadErrors++;
+      if(++errorsInRow >= maxReadErrors)
+	return ReadError;
+    }
+    else
+      errorsInRow = 0;
+
+    if(now >= deadline) {
+      nTimeouts++;
+      return TimedOut;
+    }
+
+    // Never sleep past the deadline
+    uint64_t sleep = delay;
+    if(now + sleep > deadline)
+      sleep = deadline - now;
+    usleep(sleep);
+    if(delay < maxDelay)
+      delay = (delay * 2 < maxDelay) ? delay * 2 : maxDelay;
+  }
+}
+
+void CaptureWaiter::printHistogram(const char *owner) const
+{
+  cout << owner << " capture waits: " << nPolls << " polls, " << nTimeouts << " timeouts, "
+       << nReadErrors << " read errors, longest " << maxUs << " us" << endl;
+  for(uint32_t i = 0; i < NBins; i++) {
+    if(bins[i] == 0)
+      continue;
+    cout << "  < " << (uint64_t(1) << i) << " us: " << bins[i] << endl;
+  }
+}
@@ -0,0 +1,70 @@
+#ifndef CaptureWaiter_hh
+#define CaptureWaiter_hh
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+
+/*
+ * Polls a CTP7 capture until it is done, backing off exponentially from
+ * initialDelayUs to maxDelayUs between polls and giving up at a deadline.
+ * cancel() may be called from another thread to stop a wait early.
+ *
+ * Every completed wait is recorded in a histogram of wait times with one
+ * bin per power of two microseconds.
+ */
+
+class CaptureWaiter {
+
+public:
+
+  enum Result {
+    Done = 0,
+    TimedOut,
+    Cancelled,
+    ReadError        // the poll failed several times in a row
+  };
+
+  // The poll returns 1 when the capture is done, 0 if not yet, -1 on a read error
+  typedef std::function<int ()> Poll;
+
+  CaptureWaiter(uint32_t initialDelayUs = 5, uint32_t maxDelayUs = 1000, uint32_t timeoutMs = 1000);
+  ~CaptureWaiter() {;}
+
+  void configure(uint32_t initialDelayUs, uint32_t maxDelayUs, uint32_t timeoutMs);
+
+  Result wait(const Poll &poll);
+
+  void cancel() {cancelled = true;}
+  void resume() {cancelled = false;}
+
+  static const char *resultName(Result result);
+
+  static const uint32_t NBins = 32;
+
+  // Waits that ended Done, bin i holding those of [2^(i-1), 2^i) microseconds
+  const uint64_t *histogram() const {return bins;}
+  uint64_t timeouts() const {return nTimeouts;}
+  uint64_t readErrors() const {return nReadErrors;}
+  uint64_t polls() const {return nPolls;}
+  uint64_t maxWaitUs() const {return maxUs;}
+
+  void printHistogram(const char *owner) const;
+
+private:
+
+  uint32_t initialDelay;
+  uint32_t maxDelay;
+  uint64_t timeout;
+
+  std::atomic<bool> cancelled;
+
+  uint64_t bins[NBins];
+  uint64_t nTimeouts;
+  uint64_t nReadErrors;
+  uint64_t nPolls;
+  uint64_t maxUs;
+
+};
+
+#endif
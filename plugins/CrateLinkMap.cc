@@ -0,0 +1,160 @@
+#include <iostream>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "CTP7Client.hh"
+#include "RCTInfoFactory.hh"
+#include "CrateLinkMap.hh"
+
+/*
+ * Cabling used before the link IDs were read back from the CTP7
+ * {even, odd} link for crates 0-17
+ */
+
+static const int ctp7Links[NRCTCrates][2] = {
+  {15, 16}, // LinkID a,    b
+  {18, 19}, // LinkID 10a,  10b
+  {20, 21}, // LinkID 20a,  20b
+  {12, 14}, // LinkID 30a,  30b
+  {13, 23}, // LinkID 40a,  40b
+  {17, 22}, // LinkID 50a,  50b
+  { 2,  4}, // LinkID 60a,  60b
+  { 5,  7}, // LinkID 70a,  70b
+  {10,  8}, // LinkID 80a,  80b
+  { 0,  3}, // LinkID 90a,  90b
+  { 1,  9}, // LinkID a0a,  a0b
+  { 6, 11}, // LinkID b0a,  b0b
+  {27, 28}, // LinkID c0a,  c0b
+  {30, 31}, // LinkID d0a,  d0b
+  {32, 33}, // LinkID e0a,  e0b
+  {24, 26}, // LinkID f0a,  f0b
+  {25, 35}, // LinkID 100a, 100b
+  {29, 34}  // LinkID 110a, 110b
+};
+
+static const int mp7Links[NRCTCrates][2] = {
+  { 0,  1}, { 8,  9}, {16, 17}, {24, 25}, {32, 33}, {28, 29},
+  {20, 21}, {12, 13}, { 4,  5}, { 2,  3}, {10, 11}, {18, 19},
+  {26, 27}, {34, 35}, {30, 31}, {22, 23}, {14, 15}, { 6,  7}
+};
+
+void CrateLinkMap::setDefault(bool mp7Mapping)
+{
+  memcpy(link, mp7Mapping ? mp7Links : ctp7Links, sizeof(link));
+}
+
+/*
+ * Fibers no link claims get link -1 and are left out, rather than keep a
+ * default link another crate may have been found on; a partially cabled
+ * board still decodes the crates that are present
+ */
+
+bool CrateLinkMap::fill(const std::vector<uint32_t> &linkIDs)
+{
+  bool found[NRCTCrates][2];
+  memset(found, 0, sizeof(found));
+
+  for(uint32_t iLink = 0; iLink < linkIDs.size(); iLink++) {
+    unsigned int crate, linkNumber;
+    bool even;
+    RCTInfoFactory::decodeCapturedLinkID(linkIDs[iLink], crate, linkNumber, even);
+    if(crate == 0xFF || linkNumber == 0xFF)
+      continue;
+    int side = even ? 0 : 1;
+    if(found[crate][side]) {
+      std::cerr << "CrateLinkMap::fill() crate " << crate << (even ? " even" : " odd")
+		<< " found on links " << link[crate][side] << " and " << iLink << std::endl;
+      continue;
+    }
+    found[crate][side] = true;
+    link[crate][side] = iLink;
+  }
+
+  bool complete = true;
+  for(unsigned int crate = 0; crate < NRCTCrates; crate++) {
+    for(int side = 0; side < 2; side++) {
+      if(!found[crate][side]) {
+	std::cerr << "CrateLinkMap::fill() no link ID for crate " << crate << (side == 0 ? " even" : " odd")
+		  << ", leaving it out" << std::endl;
+	link[crate][side] = -1;
+	complete = false;
+      }
+    }
+  }
+  return complete;
+}
+
+bool CrateLinkMap::discover(CTP7Client *ctp7Client, const std::string &cacheDir)
+{
+  char fileName[256] = "";
+  CTP7::MiscRegisters miscRegisters;
+  if(!cacheDir.empty() && ctp7Client->getMiscRegisters(&miscRegisters) && miscRegisters.GITHASH_DIRTY_REG == 0) {
+    snprintf(fileName, sizeof(fileName), "%s/CTP7LinkMap-%08x.txt", cacheDir.c_str(), miscRegisters.GITHASH_CODE_REG);
+    if(load(fileName)) {
+      std::cout << "CrateLinkMap::discover() using cached map " << fileName << std::endl;
+      return true;
+    }
+  }
+
+  std::vector<uint32_t> linkIDs;
+  if(!ctp7Client->dumpAllLinkIDs(linkIDs)) {
+    std::cerr << "CrateLinkMap::discover() Error reading link IDs from CTP7" << std::endl;
+    return false;
+  }
+
+  // Only cache a map where every crate was found
+  bool complete = fill(linkIDs);
+  if(complete && fileName[0] != '\0')
+    save(fileName);
+  return complete;
+}
+
+/*
+ * Cache file has one line per crate: "crate evenLink oddLink"; every crate
+ * must be listed once and no link given to two fibers
+ */
+
+bool CrateLinkMap::load(const std::string &fileName)
+{
+  FILE *fptr = fopen(fileName.c_str(), "r");
+  if(fptr == NULL)
+    return false;
+
+  int loaded[NRCTCrates][2];
+  bool crateSeen[NRCTCrates] = {false};
+  bool linkSeen[NILinks] = {false};
+  unsigned int nCrates = 0;
+  unsigned int crate;
+  int even, odd;
+  while(fscanf(fptr, "%u %d %d", &crate, &even, &odd) == 3) {
+    if(crate >= NRCTCrates || even < 0 || even >= NILinks || odd < 0 || odd >= NILinks ||
+       even == odd || crateSeen[crate] || linkSeen[even] || linkSeen[odd])
+      break;
+    crateSeen[crate] = linkSeen[even] = linkSeen[odd] = true;
+    loaded[crate][0] = even;
+    loaded[crate][1] = odd;
+    nCrates++;
+  }
+  fclose(fptr);
+
+  if(nCrates != NRCTCrates) {
+    std::cerr << "CrateLinkMap::load() ignoring malformed cache " << fileName << std::endl;
+    return false;
+  }
+  memcpy(link, loaded, sizeof(link));
+  return true;
+}
+
+bool CrateLinkMap::save(const std::string &fileName) const
+{
+  FILE *fptr = fopen(fileName.c_str(), "w");
+  if(fptr == NULL) {
+    std::cerr << "CrateLinkMap::save() could not write " << fileName << std::endl;
+    return false;
+  }
+  for(unsigned int crate = 0; crate < NRCTCrates; crate++)
+    fprintf(fptr, "%u %d %d\n", crate, link[crate][0], link[crate][1]);
+  fclose(fptr);
+  return true;
+}
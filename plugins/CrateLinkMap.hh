@@ -0,0 +1,48 @@
+#ifndef CrateLinkMap_hh
+#define CrateLinkMap_hh
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "DAQSpyBlock.hh"
+
+class CTP7Client;
+
+/*
+ * Map of RCT crate (even/odd fiber) to CTP7 input link number.
+ * The map is discovered from the LINK_ID_REG of every link and cached
+ * on disk keyed by the firmware GITHASH, so that lookups in the event
+ * loop are plain array loads.
+ */
+
+class CrateLinkMap {
+
+public:
+
+  CrateLinkMap() {setDefault(false);}
+  ~CrateLinkMap() {;}
+
+  // Hard-coded CTP7 or MP7 cabling, used when discovery is not possible
+  void setDefault(bool mp7Mapping);
+
+  // Build the map from the captured link IDs, indexed by CTP7 link number
+  bool fill(const std::vector<uint32_t> &linkIDs);
+
+  // Read the link IDs from the CTP7 and build the map; uses the on-disk
+  // cache in cacheDir (empty to disable) when the firmware hash is known
+  bool discover(CTP7Client *ctp7Client, const std::string &cacheDir);
+
+  bool load(const std::string &fileName);
+  bool save(const std::string &fileName) const;
+
+  // -1 for a fiber fill() found on no link
+  int getLinkNumber(bool even, unsigned int crate) const {return link[crate][even ? 0 : 1];}
+
+private:
+
+  int link[NRCTCrates][2];
+
+};
+
+#endif
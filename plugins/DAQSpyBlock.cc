@@ -0,0 +1,102 @@
+#include <iostream>
+#include <stdint.h>
+
+#include "DAQSpyBlock.hh"
+#include "RCTInfoFactory.hh"
+
+uint32_t DAQSpyBlock::reportCrates(const char *owner) const
+{
+  uint32_t nComplete = 0;
+  for(uint32_t crate = 0; crate < NRCTCrates; crate++) {
+    if(crateComplete(crate))
+      nComplete++;
+    for(uint32_t parity = 0; parity < 2; parity++) {
+      const char *name = (parity == 0) ? "even" : "odd";
+      if(crateLinks[crate][parity] < 0)
+	std::cerr << owner << ": crate " << crate << " " << name << " link missing" << std::endl;
+      else if(nDuplicates[crate][parity] != 0)
+	std::cerr << owner << ": crate " << crate << " " << name << " link seen " << nDuplicates[crate][parity] + 1
+		  << " times, using CTP7 link " << crateLinks[crate][parity] << std::endl;
+    }
+  }
+  if(nUnassigned != 0)
+    std::cerr << owner << ": " << nUnassigned << " links with an invalid link ID" << std::endl;
+  return nComplete;
+}
+
+const char *DAQSpyBlock::statusName(Status status)
+{
+  switch(status) {
+  case Ok: return "ok";
+  case CorruptedLinks: return "corrupted links";
+  case Truncated: return "truncated";
+  case BadHeader: return "bad header";
+  }
+  return "unknown";
+}
+
+DAQSpyBlock::Status DAQSpyBlock::parse(const uint32_t *buffer, uint32_t nWords, uint32_t eventWords)
+{
+  this->buffer = buffer;
+  nBXs = 0;
+  expectedSize = 0;
+  headerSize = 0;
+  sizeDisagrees = false;
+  badLinks = 0;
+  crcLinks = 0;
+  parseStatus = BadHeader;
+  for(uint32_t crate = 0; crate < NRCTCrates; crate++) {
+    for(uint32_t parity = 0; parity < 2; parity++) {
+      crateLinks[crate][parity] = -1;
+      nDuplicates[crate][parity] = 0;
+    }
+  }
+  nDuplicateLinks = 0;
+  nUnassigned = 0;
+  if(nWords < EVENT_HEADER_WORDS)
+    return parseStatus;
+
+  uint32_t nBX = (buffer[5] & 0x00FF0000) >> 16;
+  uint32_t linkWords = CHANNEL_HEADER_WORDS + nBX * CHANNEL_DATA_WORDS_PER_BX;
+  expectedSize = EVENT_HEADER_WORDS + NLinks * linkWords;
+  if(nBX == 0)
+    return parseStatus;
+
+  // Only a buffer too short for the nBX layout is truncated; sizes that
+  // disagree with it are reported, the frames are all there to decode
+  if(expectedSize > nWords) {
+    parseStatus = Truncated;
+    return parseStatus;
+  }
+  headerSize = eventSizeWords(buffer[0] & 0x000FFFFF);
+  sizeDisagrees = (headerSize != 0 && headerSize != expectedSize) || (eventWords != 0 && eventWords != expectedSize);
+
+  for(uint32_t iLink = 0; iLink < NLinks; iLink++) {
+    const uint32_t *channel = buffer + EVENT_HEADER_WORDS + iLink * linkWords;
+    DAQLinkView &view = links[iLink];
+    view.linkID = channel[0];
+    view.crcErrors = channel[1] & 0x0000FFFF;
+    view.status = (channel[1] & 0xFFFF0000) >> 16;
+    view.data = channel + CHANNEL_HEADER_WORDS;
+    RCTInfoFactory::decodeCapturedLinkID(view.linkID, view.crate, view.linkNumber, view.even);
+
+    bool invalid = (view.crate >= NRCTCrates) | (view.linkNumber == 0xFF);
+    badLinks |= uint64_t(invalid) << iLink;
+    crcLinks |= uint64_t(view.crcErrors != 0) << iLink;
+    if(invalid) {
+      nUnassigned++;
+      continue;
+    }
+    uint32_t parity = view.even ? 0 : 1;
+    if(crateLinks[view.crate][parity] < 0)
+      crateLinks[view.crate][parity] = iLink;
+    else {
+      nDuplicates[view.crate][parity]++;
+      nDuplicateLinks++;
+    }
+  }
+
+  nBXs = nBX;
+  parseStatus = (badLinks == 0) ? Ok : CorruptedLinks;
+  return parseStatus;
+}
@@ -0,0 +1,127 @@
+#ifndef DAQSpyBlock_hh
+#define DAQSpyBlock_hh
+
+#include <stdint.h>
+
+#define EVENT_HEADER_WORDS 6
+#define CHANNEL_HEADER_WORDS 2
+#define CHANNEL_DATA_WORDS_PER_BX 6
+#define NIntsBRAMDAQ 1024*2
+#define NLinks 36
+#define NRCTCrates 18
+
+/*
+ * Read-only view of one link in the DAQ spy buffer: the decoded channel
+ * header and a pointer to its nBX consecutive 6-word frames.
+ */
+
+struct DAQLinkView {
+  const uint32_t *data;
+  uint32_t linkID;
+  uint32_t crcErrors;
+  uint32_t status;
+  uint32_t crate;          // 0xFF if not a valid crate
+  uint32_t linkNumber;     // 0xFF if not a valid oRSC link
+  bool even;
+};
+
+/*
+ * Parses the event and channel headers of a DAQ spy buffer in place.
+ * Nothing is copied or allocated: frames are addressed straight in the
+ * caller's buffer, which must outlive the views.
+ *
+ * Buffer layout: EVENT_HEADER_WORDS, then per link CHANNEL_HEADER_WORDS
+ * (link ID; CRC error count | status << 16) and nBX frames.
+ *
+ * The same pass indexes the links by (crate, even/odd), keeping the first
+ * link seen for each and counting any further ones as duplicates.
+ *
+ * parse() checks the header once: nBX against the buffer size, after which
+ * frames are addressed without further checks. The event size in header
+ * word 0 and, when known, the one DAQ_SPY_CAPTURE_EVENT_SIZE_REG reported
+ * are cross-checked against nBX; a disagreement is only flagged in
+ * sizeMismatch(), as the frames are still all in the buffer. Links with an
+ * invalid link ID are flagged in corruptedLinks() and left out of the
+ * crate index.
+ *
+ * The CTP7 counts event sizes in 64 bit words plus one trailer word, in
+ * header word 0 (bits 0-19) and in the register alike: 0x244 for 5 BXs,
+ * which is 2 * (0x244 - 1) = 1158 words.
+ */
+
+class DAQSpyBlock {
+
+public:
+
+  DAQSpyBlock() : buffer(0), nBXs(0), parseStatus(BadHeader), expectedSize(0), headerSize(0), sizeDisagrees(false),
+    badLinks(0), crcLinks(0) {;}
+  ~DAQSpyBlock() {;}
+
+  enum Status {
+    Ok = 0,
+    CorruptedLinks,    // usable, but the links in corruptedLinks() were left out
+    Truncated,         // nBX frames per link do not fit in the buffer
+    BadHeader          // no event header, or no BXs read out
+  };
+
+  // eventWords is the event size in words the readout reported, 0 if not known
+  Status parse(const uint32_t *buffer, uint32_t nWords, uint32_t eventWords = 0);
+
+  // A CTP7 event size (header word 0 or DAQ_SPY_CAPTURE_EVENT_SIZE_REG) in 32 bit words, 0 for 0
+  static uint32_t eventSizeWords(uint32_t eventSize) {return eventSize == 0 ? 0 : 2 * (eventSize - 1);}
+
+  Status status() const {return parseStatus;}
+  static const char *statusName(Status status);
+
+  // Words the nBX of the header says the event takes, and those header word 0 gives (0 if not set)
+  uint32_t expectedWords() const {return expectedSize;}
+  uint32_t headerWords() const {return headerSize;}
+
+  // Header word 0 or the reported event size disagree with expectedWords()
+  bool sizeMismatch() const {return sizeDisagrees;}
+
+  // Bit iLink set for links with an invalid ID, or with a nonzero CRC error count
+  uint64_t corruptedLinks() const {return badLinks;}
+  uint64_t crcErrorLinks() const {return crcLinks;}
+
+  uint32_t l1ID() const {return buffer[1];}
+  uint32_t firmwareVersion() const {return buffer[4];}
+  uint32_t l1aBCID() const {return buffer[5] & 0x00000FFF;}
+  uint32_t nBX() const {return nBXs;}
+
+  const DAQLinkView &link(uint32_t iLink) const {return links[iLink];}
+
+  // Position of the even or odd link of a crate, -1 if it was not found
+  int crateLink(uint32_t crate, bool even) const {return crateLinks[crate][even ? 0 : 1];}
+  uint32_t duplicateLinks(uint32_t crate, bool even) const {return nDuplicates[crate][even ? 0 : 1];}
+  bool crateComplete(uint32_t crate) const {return crateLinks[crate][0] >= 0 && crateLinks[crate][1] >= 0;}
+  bool hasDuplicates() const {return nDuplicateLinks != 0;}
+
+  // Prints what is wrong with each crate; returns the number of complete crates
+  uint32_t reportCrates(const char *owner) const;
+
+  // The 6 words of link iLink in BX iBX of the readout window
+  const uint32_t *frame(uint32_t iLink, uint32_t iBX) const {
+    return links[iLink].data + iBX * CHANNEL_DATA_WORDS_PER_BX;
+  }
+
+private:
+
+  const uint32_t *buffer;
+  uint32_t nBXs;
+  Status parseStatus;
+  uint32_t expectedSize;
+  uint32_t headerSize;
+  bool sizeDisagrees;
+  uint64_t badLinks;
+  uint64_t crcLinks;
+  DAQLinkView links[NLinks];
+
+  int crateLinks[NRCTCrates][2];
+  uint32_t nDuplicates[NRCTCrates][2];
+  uint32_t nDuplicateLinks;
+  uint32_t nUnassigned;
+
+};
+
+#endif
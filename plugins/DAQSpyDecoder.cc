@@ -0,0 +1,162 @@
+#include <stdint.h>
+
+#include "tbb/blocked_range.h"
+#include "tbb/combinable.h"
+#include "tbb/parallel_for.h"
+
+#include "DataFormats/L1CaloTrigger/interface/L1CaloEmCand.h"
+#include "DataFormats/L1CaloTrigger/interface/L1CaloRegion.h"
+
+#include "DAQSpyDecoder.hh"
+
+// Run f(unit) for every unit, on the TBB pool when there is more than one
+template <typename F>
+static void forEachUnit(bool parallel, uint32_t nUnits, const F &f)
+{
+  if(!parallel || nUnits < 2) {
+    for(uint32_t unit = 0; unit < nUnits; unit++)
+      f(unit);
+    return;
+  }
+  tbb::parallel_for(tbb::blocked_range<uint32_t>(0, nUnits),
+		    [&f](const tbb::blocked_range<uint32_t> &range) {
+		      for(uint32_t unit = range.begin(); unit != range.end(); unit++)
+			f(unit);
+		    });
+}
+
+DAQSpyBlock::Status DAQSpyDecoder::decode(const DAQSpyBlock &block)
+{
+  nCrates = 0;
+  nBXs = 0;
+  nBadUnits = 0;
+  errors.clear();
+  badLinks = block.corruptedLinks();
+  if(block.status() != DAQSpyBlock::Ok && block.status() != DAQSpyBlock::CorruptedLinks)
+    return block.status();
+
+  for(uint32_t crate = 0; crate < NRCTCrates; crate++)
+    if(block.crateComplete(crate))
+      crates[nCrates++] = crate;
+  nBXs = block.nBX();
+
+  uint32_t nUnits = nCrates * nBXs;
+  frames.resize(nUnits);
+  status.resize(nUnits);
+
+  //Tasks count errors in to per thread copies, merged below
+  bool threaded = parallel && nUnits > 1;
+  tbb::combinable<RCTFrameErrors> threadErrors;
+
+  forEachUnit(parallel, nUnits, [this, &block, threaded, &threadErrors](uint32_t unit) {
+      uint32_t iBX = unit / nCrates;
+      uint32_t crate = crates[unit % nCrates];
+      RCTInfoFactory rctInfoFactory;
+      rctInfoFactory.setCheckByteCheck(checkByteCheck);
+      rctInfoFactory.setErrorStats(threaded ? &threadErrors.local() : &errors);
+      rctInfoFactory.setLinks(block.crateLink(crate, true), block.crateLink(crate, false), iBX);
+      RCTInfoFactory::FiberSpan even(block.frame(block.crateLink(crate, true), iBX), CHANNEL_DATA_WORDS_PER_BX);
+      RCTInfoFactory::FiberSpan odd(block.frame(block.crateLink(crate, false), iBX), CHANNEL_DATA_WORDS_PER_BX);
+      rctInfoFactory.produce(even, odd, &frames[unit], &status[unit], 1);
+    });
+  if(threaded)
+    threadErrors.combine_each([this](const RCTFrameErrors &e) {errors.merge(e);});
+
+  // Serial pass over the unit flags: drop bad units, number the good ones
+  outputSlot.resize(nUnits);
+  uint32_t nGood = 0;
+  for(uint32_t unit = 0; unit < nUnits; unit++) {
+    outputSlot[unit] = nGood;
+    if(good(unit))
+      nGood++;
+    else {
+      uint32_t crate = crates[unit % nCrates];
+      badLinks |= (uint64_t(1) << block.crateLink(crate, true)) | (uint64_t(1) << block.crateLink(crate, false));
+    }
+  }
+  nBadUnits = nUnits - nGood;
+
+  return (badLinks == 0) ? DAQSpyBlock::Ok : DAQSpyBlock::CorruptedLinks;
+}
+
+void DAQSpyDecoder::fillCollections(L1CaloEmCollection &emCands, L1CaloRegionCollection &regions) const
+{
+  uint32_t nUnits = nCrates * nBXs;
+  uint32_t nGood = nUnits - nBadUnits;
+  uint32_t emBase = emCands.size();
+  uint32_t regionBase = regions.size();
+  emCands.resize(emBase + nGood * EmCandsPerCrate);
+  regions.resize(regionBase + nGood * RegionsPerCrate);
+
+  forEachUnit(parallel, nUnits, [&](uint32_t unit) {
+      if(good(unit))
+	emitCrate(frames[unit], crates[unit % nCrates], unit / nCrates,
+		  &emCands[emBase + outputSlot[unit] * EmCandsPerCrate],
+		  &regions[regionBase + outputSlot[unit] * RegionsPerCrate]);
+    });
+}
+
+/*
+ * Bit i of a 7 bit value moved to bit 4i, so the overflow, tau and MIP bits
+ * of the 7 regions of a half crate spread in to one flag nibble per region
+ */
+
+namespace {
+  struct NibbleSpread {
+    NibbleSpread() {
+      for(uint32_t v = 0; v < 128; v++) {
+	bits[v] = 0;
+	for(uint32_t i = 0; i < 7; i++)
+	  bits[v] |= ((v >> i) & 0x1) << (4 * i);
+      }
+    }
+    uint32_t bits[128];
+  };
+  const NibbleSpread nibbleSpread;
+}
+
+void DAQSpyDecoder::emitCrate(const RCTInfoPacked &info, uint32_t crate, int16_t bx, L1CaloEmCand *em, L1CaloRegion *rgn)
+{
+  //Use Crate ID to identify eta/phi of candidate
+  for(int j = 0; j < 4; j++) {
+    *em = L1CaloEmCand(info.neRank(j), info.neRegn(j), info.neCard(j), crate, false);
+    (em++)->setBx(bx);
+  }
+  for(int j = 0; j < 4; j++) {
+    *em = L1CaloEmCand(info.ieRank(j), info.ieRegn(j), info.ieCard(j), crate, true);
+    (em++)->setBx(bx);
+  }
+
+  //Flag nibbles of regions 0-6 and 7-13: overflow bit 0, tau bit 1, MIP bit 2.
+  //The fibers carry no quiet bits
+  uint32_t oBits = info.oBits();
+  uint32_t tBits = info.tBits();
+  uint32_t mBits = info.mBits();
+  uint32_t flags[2];
+  for(int h = 0; h < 2; h++)
+    flags[h] = nibbleSpread.bits[(oBits >> (7 * h)) & 0x7F] |
+      (nibbleSpread.bits[(tBits >> (7 * h)) & 0x7F] << 1) |
+      (nibbleSpread.bits[(mBits >> (7 * h)) & 0x7F] << 2);
+  for(int j = 0; j < 7; j++) {
+    for(int k = 0; k < 2; k++) {
+      uint32_t r = j * 2 + k;
+      uint32_t f = flags[r / 7] >> (4 * (r % 7));
+      *rgn = L1CaloRegion(info.rgnEt(j, k), f & 0x1, f & 0x2, f & 0x4, false, crate, j, k);
+      (rgn++)->setBx(bx);
+    }
+  }
+
+  uint32_t hfQBits = info.hfQBits();
+  for(int j = 0; j < 2; j++) {
+    for(int k = 0; k < 4; k++) {
+      *rgn = L1CaloRegion(info.hfEt(j, k), (hfQBits >> (j * 4 + k)) & 0x1, crate, (j * 4 + k));
+      (rgn++)->setBx(bx);
+    }
+  }
+}
+
+void DAQSpyDecoder::bxInfo(uint32_t iBX, RCTInfo *rctInfo) const
+{
+  for(uint32_t i = 0; i < nCrates; i++)
+    frames[iBX * nCrates + i].unpack(rctInfo[i], crates[i]);
+}
@@ -0,0 +1,99 @@
+#ifndef DAQSpyDecoder_hh
+#define DAQSpyDecoder_hh
+
+#include <stdint.h>
+#include <vector>
+
+#include "DataFormats/L1CaloTrigger/interface/L1CaloCollections.h"
+
+#include "RCTInfo.hh"
+#include "RCTInfoPacked.hh"
+#include "DAQSpyBlock.hh"
+#include "RCTInfoFactory.hh"
+
+/*
+ * Decodes every complete crate of every BX of a DAQSpyBlock.
+ *
+ * Each (crate, BX) pair is an independent unit that writes only its own
+ * preallocated slot, so the units run as TBB tasks. Results are laid out
+ * BX by BX in crate order, which keeps the output the same whatever the
+ * task scheduling was.
+ *
+ * A (crate, BX) whose frames fail the BX byte check is left out of the
+ * collections and both links of the crate are reported as corrupted;
+ * the rest of the event is kept. Frame errors are counted in frameErrors(),
+ * not printed.
+ */
+
+class DAQSpyDecoder {
+
+public:
+
+  DAQSpyDecoder() : parallel(true), checkByteCheck(false), nCrates(0), nBXs(0), badLinks(0), nBadUnits(0) {;}
+  ~DAQSpyDecoder() {;}
+
+  void setParallel(bool p) {parallel = p;}
+
+  // Verify the check byte of every frame; only for blocks DAQSpyPacker packed
+  // with check bytes, see FrameCheckByte. Mismatches are counted in frameErrors()
+  void setCheckByteCheck(bool check) {checkByteCheck = check;}
+
+  // The block status if it is unusable, else Ok or CorruptedLinks
+  DAQSpyBlock::Status decode(const DAQSpyBlock &block);
+
+  // Links left out by the block or by the frame checks, bit iLink set
+  uint64_t corruptedLinks() const {return badLinks;}
+  uint32_t badUnits() const {return nBadUnits;}
+
+  // Frame errors of the last decode by type, link and BX
+  const RCTFrameErrors &frameErrors() const {return errors;}
+
+  uint32_t cratesFound() const {return nCrates;}
+  uint32_t nBX() const {return nBXs;}
+
+  // The cratesFound() crates of BX iBX, as their fiber words or unpacked in to rctInfo[cratesFound()]
+  const RCTInfoPacked *bxFrames(uint32_t iBX) const {return &frames[iBX * nCrates];}
+  void bxInfo(uint32_t iBX, RCTInfo *rctInfo) const;
+  // False for crate i of BX iBX if its BX bytes were bad; its fields are not filled then
+  bool crateGood(uint32_t iBX, uint32_t i) const {return good(iBX * nCrates + i);}
+
+  // Appends 8 EM candidates and 22 regions per good crate and BX, in BX then crate order
+  void fillCollections(L1CaloEmCollection &emCands, L1CaloRegionCollection &regions) const;
+
+  static const uint32_t EmCandsPerCrate = 8;
+  static const uint32_t RegionsPerCrate = 22;
+
+  // The EmCandsPerCrate candidates and RegionsPerCrate regions of one crate and BX,
+  // straight from its fiber words in to em[] and rgn[]
+  static void emitCrate(const RCTInfoPacked &info, uint32_t crate, int16_t bx, L1CaloEmCand *em, L1CaloRegion *rgn);
+
+private:
+
+  DAQSpyDecoder(const DAQSpyDecoder&);
+  const DAQSpyDecoder& operator=(const DAQSpyDecoder&);
+
+  bool good(uint32_t unit) const {return status[unit] != RCTInfoFactory::FRAME_BAD_BX_BYTE;}
+
+  bool parallel;
+  bool checkByteCheck;
+
+  // Crate number of each crate slot
+  uint32_t crates[NRCTCrates];
+  uint32_t nCrates;
+  uint32_t nBXs;
+
+  uint64_t badLinks;
+  uint32_t nBadUnits;
+  RCTFrameErrors errors;
+
+  // 48 bytes per unit; fields are only extracted by fillCollections
+  std::vector<RCTInfoPacked> frames;
+  // RCTInfoFactory::FrameStatus of each unit
+  std::vector<unsigned char> status;
+
+  // Position of each good unit in the output, counting good units only
+  std::vector<uint32_t> outputSlot;
+
+};
+
+#endif
@@ -0,0 +1,170 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "DataFormats/L1CaloTrigger/interface/L1CaloEmCand.h"
+#include "DataFormats/L1CaloTrigger/interface/L1CaloRegion.h"
+
+#include "RCTInfoFactory.hh"
+#include "FrameCheckByte.hh"
+#include "DAQSpyPacker.hh"
+
+// BC0 mark the crates send away from BC0, as seen in captured data
+const uint32_t NoBC0 = 2;
+
+// CRC error count 0, link status as captured
+const uint32_t ChannelStatus = 0x000F0000;
+
+uint32_t DAQSpyPacker::pack(const RCTInfo *info, uint32_t nBX, uint32_t l1ID, uint32_t l1aBCID,
+			    uint32_t *buffer, uint32_t nWords) const
+{
+  if(nBX == 0 || nBX > 0xFF)
+    return 0;
+  uint32_t size = blockWords(nBX);
+  if(size > nWords)
+    return 0;
+  memset(buffer, 0, size * sizeof(uint32_t));
+
+  //Event size as the CTP7 gives it, in 64 bit words plus the trailer
+  buffer[0] = (size / 2 + 1) & 0x000FFFFF;
+  buffer[1] = l1ID;
+  buffer[4] = firmware;
+  buffer[5] = (nBX << 16) | (l1aBCID & 0x00000FFF);
+
+  //Links no crate is mapped to keep an invalid link ID
+  uint32_t linkWords = CHANNEL_HEADER_WORDS + nBX * CHANNEL_DATA_WORDS_PER_BX;
+  for(uint32_t iLink = 0; iLink < NLinks; iLink++)
+    buffer[EVENT_HEADER_WORDS + iLink * linkWords] = 0xFFFFFFFF;
+
+  for(uint32_t crate = 0; crate < NRCTCrates; crate++) {
+    int evenLink = linkMap.getLinkNumber(true, crate);
+    int oddLink = linkMap.getLinkNumber(false, crate);
+    if(evenLink < 0 || evenLink >= NLinks || oddLink < 0 || oddLink >= NLinks)
+      continue;
+    uint32_t *even = buffer + EVENT_HEADER_WORDS + evenLink * linkWords;
+    uint32_t *odd = buffer + EVENT_HEADER_WORDS + oddLink * linkWords;
+    even[0] = (crate << 8) | linkNumberEven;
+    odd[0] = (crate << 8) | (linkNumberEven + 1);
+    even[1] = ChannelStatus;
+    odd[1] = ChannelStatus;
+    for(uint32_t iBX = 0; iBX < nBX; iBX++) {
+      uint32_t *evenFrame = even + CHANNEL_HEADER_WORDS + iBX * CHANNEL_DATA_WORDS_PER_BX;
+      uint32_t *oddFrame = odd + CHANNEL_HEADER_WORDS + iBX * CHANNEL_DATA_WORDS_PER_BX;
+      RCTInfoFactory::encodeFrame(info[iBX * NRCTCrates + crate], evenFrame, oddFrame);
+      if(checkBytes) {
+	FrameCheckByte::setCheckByte(evenFrame);
+	FrameCheckByte::setCheckByte(oddFrame);
+      }
+    }
+  }
+  return size;
+}
+
+bool DAQSpyPacker::fromCollections(const L1CaloEmCollection &emCands, const L1CaloRegionCollection &regions,
+				   uint32_t nBX, std::vector<RCTInfo> &info)
+{
+  bool status = true;
+  info.assign(nBX * NRCTCrates, RCTInfo());
+  for(uint32_t i = 0; i < info.size(); i++) {
+    RCTInfo &rctInfo = info[i];
+    rctInfo.crateID = i % NRCTCrates;
+    rctInfo.c1BC0 = rctInfo.c2BC0 = rctInfo.c3BC0 = NoBC0;
+    rctInfo.c4BC0 = rctInfo.c5BC0 = rctInfo.c6BC0 = NoBC0;
+  }
+
+  //Candidates fill the 4 isolated and 4 non-isolated slots of their crate in order
+  std::vector<uint8_t> nEm(nBX * NRCTCrates * 2, 0);
+  for(uint32_t i = 0; i < emCands.size(); i++) {
+    const L1CaloEmCand &em = emCands[i];
+    uint32_t bx = em.bx();
+    uint32_t crate = em.rctCrate();
+    if(bx >= nBX || crate >= NRCTCrates) {
+      status = false;
+      continue;
+    }
+    uint32_t unit = bx * NRCTCrates + crate;
+    uint8_t &slot = nEm[unit * 2 + (em.isolated() ? 1 : 0)];
+    if(slot >= 4) {
+      status = false;
+      continue;
+    }
+    RCTInfo &rctInfo = info[unit];
+    if(em.isolated()) {
+      rctInfo.ieRank[slot] = em.rank();
+      rctInfo.ieRegn[slot] = em.rctRegion();
+      rctInfo.ieCard[slot] = em.rctCard();
+    }
+    else {
+      rctInfo.neRank[slot] = em.rank();
+      rctInfo.neRegn[slot] = em.rctRegion();
+      rctInfo.neCard[slot] = em.rctCard();
+    }
+    slot++;
+  }
+
+  for(uint32_t i = 0; i < regions.size(); i++) {
+    const L1CaloRegion &region = regions[i];
+    uint32_t bx = region.bx();
+    uint32_t crate = region.rctCrate();
+    uint32_t index = region.rctRegionIndex();
+    if(bx >= nBX || crate >= NRCTCrates) {
+      status = false;
+      continue;
+    }
+    RCTInfo &rctInfo = info[bx * NRCTCrates + crate];
+    if(region.isHf()) {
+      if(index >= 8) {
+	status = false;
+	continue;
+      }
+      rctInfo.hfEt[index / 4][index % 4] = region.et();
+      rctInfo.hfQBits |= (region.fineGrain() ? 1u : 0u) << index;
+      continue;
+    }
+    uint32_t card = region.rctCard();
+    if(card >= 7 || index >= 2) {
+      status = false;
+      continue;
+    }
+    uint32_t bit = card * 2 + index;
+    rctInfo.rgnEt[card][index] = region.et();
+    rctInfo.oBits |= (region.overFlow() ? 1u : 0u) << bit;
+    rctInfo.tBits |= (region.tauVeto() ? 1u : 0u) << bit;
+    rctInfo.mBits |= (region.mip() ? 1u : 0u) << bit;
+    rctInfo.qBits |= (region.quiet() ? 1u : 0u) << bit;
+  }
+  return status;
+}
+
+void DAQSpyPacker::fillSynthetic(RCTInfo *info, uint32_t nInfo, uint32_t seed)
+{
+  //xorshift32; any nonzero seed gives a full period
+  uint32_t x = seed != 0 ? seed : 0x2545F491;
+  struct Random {
+    uint32_t &x;
+    uint32_t operator()(uint32_t nBits) {
+      x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+      return x & ((1u << nBits) - 1);
+    }
+  } random = {x};
+
+  for(uint32_t i = 0; i < nInfo; i++) {
+    RCTInfo &r = info[i];
+    r = RCTInfo();
+    r.crateID = i % NRCTCrates;
+    r.c1BC0 = r.c2BC0 = r.c3BC0 = r.c4BC0 = r.c5BC0 = r.c6BC0 = NoBC0;
+    for(int j = 0; j < 4; j++) {
+      r.ieRank[j] = random(6); r.ieRegn[j] = random(1); r.ieCard[j] = random(3);
+      r.neRank[j] = random(6); r.neRegn[j] = random(1); r.neCard[j] = random(3);
+    }
+    for(int j = 0; j < 7; j++)
+      for(int k = 0; k < 2; k++)
+	r.rgnEt[j][k] = random(10);
+    for(int j = 0; j < 2; j++)
+      for(int k = 0; k < 4; k++)
+	r.hfEt[j][k] = random(8);
+    r.oBits = random(14);
+    r.tBits = random(14);
+    r.mBits = random(14);
+    r.hfQBits = random(8);
+  }
+}
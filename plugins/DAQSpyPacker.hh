@@ -0,0 +1,65 @@
+#ifndef DAQSpyPacker_hh
+#define DAQSpyPacker_hh
+
+#include <stdint.h>
+#include <vector>
+
+#include "DataFormats/L1CaloTrigger/interface/L1CaloCollections.h"
+
+#include "RCTInfo.hh"
+#include "DAQSpyBlock.hh"
+#include "CrateLinkMap.hh"
+
+/*
+ * Builds the DAQ block DAQSpyBlock parses from decoded crates: the event
+ * header, then for every CTP7 link its channel header and frames. Crates
+ * go to the links the CrateLinkMap gives them, with link IDs as the RCT
+ * sends them, so the block decodes back to the same RCTInfo.
+ *
+ * RCTInfo is laid out BX by BX in crate order: info[iBX * NRCTCrates + crate].
+ */
+
+class DAQSpyPacker {
+
+public:
+
+  DAQSpyPacker() : firmware(0), linkNumberEven(0x0A), checkBytes(false) {linkMap.setDefault(false);}
+  ~DAQSpyPacker() {;}
+
+  void setLinkMap(const CrateLinkMap &map) {linkMap = map;}
+  void setFirmwareVersion(uint32_t version) {firmware = version;}
+
+  // Link number the crates send on their even fiber; the odd fiber is one more
+  void setLinkNumber(uint32_t even) {linkNumberEven = even;}
+
+  // Fill the FrameCheckByte of every frame, to check the packer's own output;
+  // left zero otherwise, as in captured data
+  void setCheckBytes(bool set) {checkBytes = set;}
+
+  // Words a block of nBX BXs takes
+  static uint32_t blockWords(uint32_t nBX) {
+    return EVENT_HEADER_WORDS + NLinks * (CHANNEL_HEADER_WORDS + nBX * CHANNEL_DATA_WORDS_PER_BX);
+  }
+
+  // Pack nBX BXs of all crates in to buffer; returns the words used, 0 if nWords is too small
+  uint32_t pack(const RCTInfo *info, uint32_t nBX, uint32_t l1ID, uint32_t l1aBCID,
+		uint32_t *buffer, uint32_t nWords) const;
+
+  // Crates of the collections DAQSpyDecoder::fillCollections makes, BXs 0 to nBX - 1;
+  // false if candidates were out of range or did not fit and were left out
+  static bool fromCollections(const L1CaloEmCollection &emCands, const L1CaloRegionCollection &regions,
+			      uint32_t nBX, std::vector<RCTInfo> &info);
+
+  // Every field of every crate filled with pseudo-random values, for benchmarks
+  static void fillSynthetic(RCTInfo *info, uint32_t nInfo, uint32_t seed);
+
+private:
+
+  CrateLinkMap linkMap;
+  uint32_t firmware;
+  uint32_t linkNumberEven;
+  bool checkBytes;
+
+};
+
+#endif
@@ -0,0 +1,211 @@
+#include <iostream>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <system_error>
+
+#include "DumpWriter.hh"
+
+using namespace std;
+
+static uint64_t monotonicNow()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return uint64_t(now.tv_sec) * 1000000000ULL + now.tv_nsec;
+}
+
+bool DumpWriter::SlotRing::push(uint32_t slot)
+{
+  uint32_t t = tail.load(memory_order_relaxed);
+  uint32_t next = (t + 1) % slots.size();
+  if(next == head.load(memory_order_acquire))
+    return false;
+  slots[t] = slot;
+  tail.store(next, memory_order_release);
+  return true;
+}
+
+bool DumpWriter::SlotRing::pop(uint32_t &slot)
+{
+  uint32_t h = head.load(memory_order_relaxed);
+  if(h == tail.load(memory_order_acquire))
+    return false;
+  slot = slots[h];
+  head.store((h + 1) % slots.size(), memory_order_release);
+  return true;
+}
+
+uint32_t DumpWriter::SlotRing::size() const
+{
+  uint32_t capacity = slots.size();
+  return (tail.load(memory_order_acquire) + capacity - head.load(memory_order_acquire)) % capacity;
+}
+
+DumpWriter::DumpWriter(uint32_t nBlocks, uint32_t wordsPerBlock, uint32_t queueDepth, bool dropWhenFull) :
+  nBlocks(nBlocks), wordsPerBlock(wordsPerBlock), slotWords(nBlocks * wordsPerBlock),
+  queueDepth(queueDepth > 0 ? queueDepth : 1), dropWhenFull(dropWhenFull),
+  textFormat(NoText), running(false),
+  nSubmitted(0), nWritten(0), nDropped(0), nStalls(0), stallTimeNs(0), maxDepth(0)
+{
+  pool.resize(uint64_t(this->queueDepth) * slotWords);
+  headers.resize(this->queueDepth);
+  filledSlots.resize(this->queueDepth);
+  freeSlots.resize(this->queueDepth);
+  for(uint32_t slot = 0; slot < this->queueDepth; slot++)
+    freeSlots.push(slot);
+
+  blockIds.resize(nBlocks);
+  blockPtrs.resize(nBlocks);
+  blockWords.resize(nBlocks, wordsPerBlock);
+  for(uint32_t block = 0; block < nBlocks; block++)
+    blockIds[block] = block;
+}
+
+DumpWriter::~DumpWriter()
+{
+  stop();
+}
+
+void DumpWriter::setTextFile(TextFormat format, const std::string &fileName)
+{
+  textFormat = format;
+  textFile = fileName;
+}
+
+bool DumpWriter::openCaptureFile(const std::string &fileName, bool compress)
+{
+  captureWriter.setCompression(compress);
+  return captureWriter.open(fileName);
+}
+
+bool DumpWriter::start()
+{
+  if(writer.joinable())
+    return true;
+  running = true;
+  try {
+    writer = std::thread(&DumpWriter::run, this);
+  }
+  catch(const std::system_error &e) {
+    cerr << "DumpWriter::start() could not start writer thread, writing synchronously: " << e.what() << endl;
+    running = false;
+    return false;
+  }
+  return true;
+}
+
+void DumpWriter::stop()
+{
+  if(writer.joinable()) {
+    running = false;
+    writer.join();
+  }
+  captureWriter.close();
+}
+
+int DumpWriter::acquire()
+{
+  uint32_t slot;
+  if(freeSlots.pop(slot))
+    return slot;
+
+  if(dropWhenFull) {
+    nDropped++;
+    if(nDropped == 1 || nDropped % 100 == 0)
+      cerr << "DumpWriter: writer behind by " << queueDepth << " captures, "
+	   << nDropped << " dumps dropped so far" << endl;
+    return -1;
+  }
+
+  // Back-pressure: wait for the writer to hand a slot back
+  nStalls++;
+  uint64_t start = monotonicNow();
+  while(!freeSlots.pop(slot))
+    usleep(50);
+  stallTimeNs += monotonicNow() - start;
+  return slot;
+}
+
+void DumpWriter::submit(int slot, const CaptureFile::RecordHeader &header)
+{
+  headers[slot] = header;
+  headers[slot].nBlocks = nBlocks;
+  nSubmitted++;
+
+  if(!writer.joinable()) {
+    write(slot);
+    freeSlots.push(slot);
+    nWritten++;
+    return;
+  }
+
+  filledSlots.push(slot);
+  uint32_t depth = filledSlots.size();
+  if(depth > maxDepth)
+    maxDepth = depth;
+}
+
+void DumpWriter::run()
+{
+  while(true) {
+    // Read the flag first so a stop() request never leaves a queued capture behind
+    bool stopping = !running.load();
+    uint32_t slot;
+    while(filledSlots.pop(slot)) {
+      write(slot);
+      freeSlots.push(slot);
+      nWritten++;
+    }
+    if(stopping)
+      break;
+    usleep(200);
+  }
+}
+
+void DumpWriter::write(uint32_t slot)
+{
+  const uint32_t *words = &pool[uint64_t(slot) * slotWords];
+
+  if(textFormat != NoText && !writeText(words))
+    cerr << "DumpWriter::write() Error writing " << textFile << endl;
+
+  if(captureWriter.isOpen()) {
+    for(uint32_t block = 0; block < nBlocks; block++)
+      blockPtrs[block] = words + block * wordsPerBlock;
+    if(!captureWriter.writeCapture(headers[slot], blockIds.data(), blockPtrs.data(), blockWords.data()))
+      cerr << "DumpWriter::write() Error writing capture file" << endl;
+  }
+}
+
+/*
+ * Same layout as the old synchronous dumps; the file is rewritten for every capture
+ */
+
+bool DumpWriter::writeText(const uint32_t *words)
+{
+  FILE *fptr = fopen(textFile.c_str(), "w");
+  if(fptr == 0)
+    return false;
+  setvbuf(fptr, 0, _IOFBF, 1 << 20);
+
+  for(uint32_t j = 0; j < nBlocks; j++){
+    if(textFormat == LinkText)
+      fprintf( fptr, "\nlink %i\n", j );
+    for(uint32_t i = 0; i < wordsPerBlock; i++){
+      fprintf( fptr, textFormat == LinkText ? "%x " : "%08x ", words[j * wordsPerBlock + i] );
+      if(i%6==5)
+	fputs("\n",fptr);
+    }
+  }
+
+  return fclose(fptr) == 0;
+}
+
+void DumpWriter::printStats(const char *owner) const
+{
+  cout << owner << " dumps: " << nSubmitted << " submitted, " << nWritten.load() << " written, "
+       << nDropped << " dropped, " << nStalls << " stalls (" << stallTimeNs / 1000000 << " ms waiting on disk), "
+       << "max queue depth " << maxDepth << " of " << queueDepth << endl;
+}
@@ -0,0 +1,120 @@
+#ifndef DumpWriter_hh
+#define DumpWriter_hh
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "CaptureFile.hh"
+
+/*
+ * Writes capture dumps (text files and/or the binary capture file) on a
+ * background thread so the I/O overlaps with event processing.
+ *
+ * Capture buffers come from a fixed pool of queueDepth slots and travel
+ * between the producer and the writer thread through two single producer,
+ * single consumer lock-free rings, so nothing is allocated per capture.
+ * When every slot is waiting on the disk the producer either waits for
+ * one (counted as a stall) or, with dropWhenFull, skips the dump
+ * (counted as dropped).
+ */
+
+class DumpWriter {
+
+public:
+
+  enum TextFormat {
+    NoText = 0,
+    LinkText = 1,     // "link N" followed by the link words, as outputFile.txt
+    DAQText = 2       // the DAQ buffer as 8 digit words, as outputFileDAQ.txt
+  };
+
+  // Every capture is nBlocks blocks of wordsPerBlock words
+  DumpWriter(uint32_t nBlocks, uint32_t wordsPerBlock, uint32_t queueDepth, bool dropWhenFull);
+  ~DumpWriter();
+
+  // Configure the outputs before start(); either may be left unset
+  void setTextFile(TextFormat format, const std::string &fileName);
+  bool openCaptureFile(const std::string &fileName, bool compress);
+
+  // Start the writer thread; without it submit() writes synchronously
+  bool start();
+
+  // Write everything still queued, stop the thread and close the capture file
+  void stop();
+
+  // Reserve a slot for the next capture; returns -1 if the dump is dropped
+  int acquire();
+  uint32_t *data(int slot) {return &pool[slot * slotWords];}
+
+  // Hand a filled slot to the writer; header.nBlocks is set here
+  void submit(int slot, const CaptureFile::RecordHeader &header);
+
+  void printStats(const char *owner) const;
+
+  uint64_t submitted() const {return nSubmitted;}
+  uint64_t written() const {return nWritten;}
+  uint64_t dropped() const {return nDropped;}
+  uint64_t stalls() const {return nStalls;}
+  uint64_t stallNs() const {return stallTimeNs;}
+  uint32_t maxQueued() const {return maxDepth;}
+
+private:
+
+  DumpWriter(const DumpWriter&);
+  const DumpWriter& operator=(const DumpWriter&);
+
+  // Fixed capacity ring of slot numbers; one thread pushes, one thread pops
+  class SlotRing {
+  public:
+    SlotRing() : head(0), tail(0) {;}
+    void resize(uint32_t capacity) {slots.resize(capacity + 1);}
+    bool push(uint32_t slot);
+    bool pop(uint32_t &slot);
+    uint32_t size() const;
+  private:
+    std::vector<uint32_t> slots;
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> tail;
+  };
+
+  void run();
+  void write(uint32_t slot);
+  bool writeText(const uint32_t *words);
+
+  uint32_t nBlocks;
+  uint32_t wordsPerBlock;
+  uint32_t slotWords;
+  uint32_t queueDepth;
+  bool dropWhenFull;
+
+  std::vector<uint32_t> pool;
+  std::vector<CaptureFile::RecordHeader> headers;
+  SlotRing filledSlots;
+  SlotRing freeSlots;
+
+  TextFormat textFormat;
+  std::string textFile;
+  CaptureFile::Writer captureWriter;
+
+  // Block tables for CaptureFile::Writer, used by whichever thread writes
+  std::vector<uint32_t> blockIds;
+  std::vector<const uint32_t *> blockPtrs;
+  std::vector<uint32_t> blockWords;
+
+  std::thread writer;
+  std::atomic<bool> running;
+
+  // Updated by the producer only, except nWritten which the writer owns
+  uint64_t nSubmitted;
+  std::atomic<uint64_t> nWritten;
+  uint64_t nDropped;
+  uint64_t nStalls;
+  uint64_t stallTimeNs;
+  uint32_t maxDepth;
+
+};
+
+#endif
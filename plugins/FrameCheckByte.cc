@@ -0,0 +1,60 @@
+#include <stdint.h>
+
+#include "FrameCheckByte.hh"
+
+namespace FrameCheckByte {
+
+  static const uint32_t NDataBits = 176;
+  static const uint32_t NDataBytes = NDataBits / 8;
+
+  struct Tables {
+    // Partial syndrome of each value of each data byte
+    uint8_t byteSyndrome[NDataBytes][256];
+
+    Tables() {
+      uint8_t column[NDataBits];
+      for(uint32_t i = 0, value = 3; i < NDataBits; value++) {
+	if((value & (value - 1)) != 0)
+	  column[i++] = value;
+      }
+
+      for(uint32_t b = 0; b < NDataBytes; b++) {
+	for(uint32_t v = 0; v < 256; v++) {
+	  uint8_t s = 0;
+	  for(uint32_t k = 0; k < 8; k++)
+	    if(v & (1 << k))
+	      s ^= column[8 * b + k];
+	  byteSyndrome[b][v] = s;
+	}
+      }
+    }
+  };
+
+  static const Tables tables;
+
+  // XOR of the partial syndromes of the data bytes, from byte 1 (bits 8-15) to byte 22 (bits 176-183)
+  static inline uint8_t dataSyndrome(const uint32_t *frame)
+  {
+    const uint8_t (*t)[256] = tables.byteSyndrome;
+    uint32_t w0 = frame[0], w5 = frame[5];
+    uint8_t s = t[0][(w0 >> 8) & 0xFF] ^ t[1][(w0 >> 16) & 0xFF] ^ t[2][w0 >> 24];
+    for(uint32_t w = 1; w < 5; w++) {
+      uint32_t word = frame[w];
+      const uint8_t (*tw)[256] = t + 4 * w - 1;
+      s ^= tw[0][word & 0xFF] ^ tw[1][(word >> 8) & 0xFF] ^ tw[2][(word >> 16) & 0xFF] ^ tw[3][word >> 24];
+    }
+    s ^= t[19][w5 & 0xFF] ^ t[20][(w5 >> 8) & 0xFF] ^ t[21][(w5 >> 16) & 0xFF];
+    return s;
+  }
+
+  uint8_t syndrome(const uint32_t *frame)
+  {
+    return dataSyndrome(frame) ^ uint8_t(frame[5] >> CheckShift);
+  }
+
+  void setCheckByte(uint32_t *frame)
+  {
+    frame[5] = (frame[5] & ~(0xFFu << CheckShift)) | (uint32_t(dataSyndrome(frame)) << CheckShift);
+  }
+
+}
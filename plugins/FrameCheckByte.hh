@@ -0,0 +1,32 @@
+#ifndef FrameCheckByte_hh
+#define FrameCheckByte_hh
+
+#include <stdint.h>
+
+/*
+ * Check byte DAQSpyPacker can write in to the 6-word fiber frames it packs,
+ * so a packer/unpacker chain can check its own output. Captured frames
+ * carry no such byte, so it is only ever verified on packed data and
+ * nothing is corrected.
+ *
+ * The byte sits in word 5 bits 24-31 and covers bits 8-183 of the frame
+ * (everything after the BX byte). Data bit i has the i-th number from 3 up
+ * that is not a power of two as its column, and the byte is the XOR of the
+ * columns of all set data bits; one table lookup per data byte, 22 per
+ * frame, from tables built once at load time.
+ */
+
+namespace FrameCheckByte {
+
+  const uint32_t WordsPerFrame = 6;
+  const uint32_t CheckShift = 24;   // check byte position in word 5
+
+  // Check byte of the frame's data XOR the one it carries; 0 if they match
+  uint8_t syndrome(const uint32_t *frame);
+
+  // Write the check byte of the frame's data in to word 5
+  void setCheckByte(uint32_t *frame);
+
+}
+
+#endif
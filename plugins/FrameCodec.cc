@@ -0,0 +1,113 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "FrameCodec.hh"
+
+namespace FrameCodec {
+
+  static const uint8_t RunTag = 0x40;
+  static const uint32_t MaxRun = 64;
+
+  static inline void putVarint(uint32_t value, std::vector<uint8_t> &out)
+  {
+    while(value >= 0x80) {
+      out.push_back(uint8_t(value) | 0x80);
+      value >>= 7;
+    }
+    out.push_back(uint8_t(value));
+  }
+
+  static inline bool getVarint(const uint8_t *&data, const uint8_t *end, uint32_t &value)
+  {
+    value = 0;
+    for(uint32_t shift = 0; shift < 35 && data < end; shift += 7) {
+      uint8_t byte = *data++;
+      value |= uint32_t(byte & 0x7F) << shift;
+      if((byte & 0x80) == 0)
+	return true;
+    }
+    return false;
+  }
+
+  size_t encode(const uint32_t *words, uint32_t nWords, std::vector<uint8_t> &out)
+  {
+    size_t start = out.size();
+    uint32_t previous[WordsPerFrame] = {0};
+    uint32_t run = 0;
+
+    for(uint32_t first = 0; first < nWords; first += WordsPerFrame) {
+      uint32_t n = nWords - first < WordsPerFrame ? nWords - first : WordsPerFrame;
+      const uint32_t *frame = words + first;
+
+      uint8_t mask = 0;
+      for(uint32_t i = 0; i < n; i++)
+	if(frame[i] != previous[i])
+	  mask |= 1 << i;
+
+      if(mask == 0) {
+	if(++run == MaxRun) {
+	  out.push_back(RunTag | (run - 1));
+	  run = 0;
+	}
+	continue;
+      }
+
+      if(run != 0) {
+	out.push_back(RunTag | (run - 1));
+	run = 0;
+      }
+      out.push_back(mask);
+      for(uint32_t i = 0; i < n; i++) {
+	if(mask & (1 << i))
+	  putVarint(frame[i] ^ previous[i], out);
+	previous[i] = frame[i];
+      }
+    }
+
+    if(run != 0)
+      out.push_back(RunTag | (run - 1));
+
+    return out.size() - start;
+  }
+
+  bool decode(const uint8_t *data, size_t nBytes, uint32_t *words, uint32_t nWords)
+  {
+    const uint8_t *end = data + nBytes;
+    uint32_t previous[WordsPerFrame] = {0};
+    uint32_t first = 0;
+
+    while(first < nWords) {
+      if(data == end)
+	return false;
+      uint8_t tag = *data++;
+
+      if(tag & RunTag) {
+	for(uint32_t r = (tag & 0x3F) + 1; r > 0; r--) {
+	  if(first >= nWords)
+	    return false;
+	  uint32_t n = nWords - first < WordsPerFrame ? nWords - first : WordsPerFrame;
+	  memcpy(words + first, previous, n * sizeof(uint32_t));
+	  first += n;
+	}
+	continue;
+      }
+
+      if(tag == 0 || (tag & 0x80))
+	return false;
+      uint32_t n = nWords - first < WordsPerFrame ? nWords - first : WordsPerFrame;
+      for(uint32_t i = 0; i < n; i++) {
+	if(tag & (1 << i)) {
+	  uint32_t delta;
+	  if(!getVarint(data, end, delta))
+	    return false;
+	  previous[i] ^= delta;
+	}
+	words[first + i] = previous[i];
+      }
+      first += n;
+    }
+
+    return data == end;
+  }
+
+}
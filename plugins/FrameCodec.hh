@@ -0,0 +1,37 @@
+#ifndef FrameCodec_hh
+#define FrameCodec_hh
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+/*
+ * Lossless codec for link data made of 6-word RCT frames.
+ *
+ * Each frame is XORed with the previous frame (the previous BX on the
+ * same link), so idle frames and the abort gap become all zero. A frame
+ * is then stored as one tag byte:
+ *   0x01-0x3F  mask of the words that changed, followed by the XOR delta
+ *              of each of those words as a little endian base-128 varint
+ *   0x40-0x7F  (tag & 0x3F) + 1 frames identical to the previous frame
+ * A trailing partial frame is coded the same way with fewer words.
+ */
+
+namespace FrameCodec {
+
+  const uint32_t WordsPerFrame = 6;
+
+  // Appends the encoding of nWords words to out; returns the number of bytes added
+  size_t encode(const uint32_t *words, uint32_t nWords, std::vector<uint8_t> &out);
+
+  // Decodes exactly nWords words; false if the data is truncated or malformed
+  bool decode(const uint8_t *data, size_t nBytes, uint32_t *words, uint32_t nWords);
+
+  // Largest possible encoding of nWords words
+  inline size_t maxEncodedSize(uint32_t nWords) {
+    return (nWords + WordsPerFrame - 1) / WordsPerFrame + nWords * 5;
+  }
+
+}
+
+#endif
@@ -0,0 +1,149 @@
+#include <iostream>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "PatternFileLoader.hh"
+
+/*
+ * Hex digit values, 0xFF for anything that is not a hex digit
+ */
+
+struct HexTable {
+  uint8_t value[256];
+  HexTable() {
+    memset(value, 0xFF, sizeof(value));
+    for(int i = 0; i < 10; i++) value['0' + i] = i;
+    for(int i = 0; i < 6; i++) {
+      value['a' + i] = 10 + i;
+      value['A' + i] = 10 + i;
+    }
+  }
+};
+
+static const HexTable hexTable;
+
+static inline bool isSpace(char c) {return c == ' ' || c == '\n' || c == '\t' || c == '\r';}
+
+bool PatternFileLoader::parse(const std::string &fileName, bool linkSections)
+{
+  int fd = open(fileName.c_str(), O_RDONLY);
+  if(fd < 0) {
+    std::cout << "Error: Could not open emulator input file " << fileName << std::endl;
+    return false;
+  }
+
+  struct stat fileStat;
+  if(fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+    close(fd);
+    return false;
+  }
+
+  // Already parsed and unchanged on disk
+  if(fileName == cachedName && linkSections == cachedLinkSections &&
+     fileStat.st_size == cachedSize && fileStat.st_mtime == cachedMTime) {
+    close(fd);
+    return true;
+  }
+
+  const char *data = (const char *) mmap(0, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(data == MAP_FAILED) {
+    std::cout << "Error: Could not map emulator input file " << fileName << std::endl;
+    return false;
+  }
+  madvise((void *) data, fileStat.st_size, MADV_SEQUENTIAL);
+
+  cachedName.clear();
+  words.clear();
+  nLinkWords.clear();
+  if(linkSections) {
+    words.assign(NILinks * NIntsPerLink, 0);
+    nLinkWords.assign(NILinks, 0);
+  }
+
+  // Words before the first "link" line (or of an unknown link) are dropped
+  uint32_t *linkWords = 0;
+  uint32_t *nWords = 0;
+
+  const char *p = data;
+  const char *end = data + fileStat.st_size;
+  while(p < end) {
+    if(isSpace(*p)) {
+      p++;
+      continue;
+    }
+    const char *token = p;
+    while(p < end && !isSpace(*p)) p++;
+
+    if(p - token == 4 && memcmp(token, "link", 4) == 0) {
+      if(!linkSections) continue;
+      while(p < end && isSpace(*p)) p++;
+      uint32_t link = 0;
+      while(p < end && *p >= '0' && *p <= '9') link = link * 10 + (*p++ - '0');
+      linkWords = 0;
+      nWords = 0;
+      if(link < NILinks) {
+	linkWords = &words[link * NIntsPerLink];
+	nWords = &nLinkWords[link];
+      }
+      continue;
+    }
+
+    // Accumulate up to 8 hex digits; the digit check is folded in to one OR
+    if(p - token > 2 && token[0] == '0' && (token[1] == 'x' || token[1] == 'X')) token += 2;
+    uint32_t value = 0;
+    uint8_t bad = 0;
+    for(const char *c = token; c < p; c++) {
+      uint8_t digit = hexTable.value[(uint8_t) *c];
+      bad |= digit;
+      value = (value << 4) | (digit & 0xF);
+    }
+    if((bad & 0xF0) != 0 || p - token > 8)
+      continue;
+
+    if(!linkSections)
+      words.push_back(value);
+    else if(linkWords != 0 && *nWords < NIntsPerLink)
+      linkWords[(*nWords)++] = value;
+  }
+
+  munmap((void *) data, fileStat.st_size);
+
+  cachedName = fileName;
+  cachedSize = fileStat.st_size;
+  cachedMTime = fileStat.st_mtime;
+  cachedLinkSections = linkSections;
+  return true;
+}
+
+bool PatternFileLoader::loadLinks(const std::string &fileName, uint32_t buffer[NILinks][NIntsPerLink], unsigned int offset)
+{
+  if(!parse(fileName, true))
+    return false;
+
+  if(offset >= NIntsPerLink) offset = 0;
+  bool status = true;
+  for(uint32_t link = 0; link < NILinks; link++) {
+    if(nLinkWords[link] == 0) {
+      std::cout << "Error: no data for link " << link << " in " << fileName << std::endl;
+      status = false;
+    }
+    memcpy(buffer[link], &words[link * NIntsPerLink + offset], (NIntsPerLink - offset) * sizeof(uint32_t));
+  }
+  return status;
+}
+
+bool PatternFileLoader::loadWords(const std::string &fileName, uint32_t *buffer, uint32_t maxWords)
+{
+  if(!parse(fileName, false))
+    return false;
+
+  uint32_t nWords = words.size();
+  if(nWords > maxWords) nWords = maxWords;
+  memcpy(buffer, words.data(), nWords * sizeof(uint32_t));
+  return nWords != 0;
+}
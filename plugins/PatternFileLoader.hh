@@ -0,0 +1,47 @@
+#ifndef PatternFileLoader_hh
+#define PatternFileLoader_hh
+
+#include <stdint.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+#include "CTP7.hh"
+
+/*
+ * Loads test pattern files (see test/testFile.txt, test/MP7InputBuffer.txt
+ * and test/daqBuffers) by memory mapping them and parsing all words in a
+ * single pass. The parsed words are cached until the file changes, so
+ * repeated test captures only copy them.
+ */
+
+class PatternFileLoader {
+
+public:
+
+  PatternFileLoader() : cachedSize(0), cachedMTime(0), cachedLinkSections(false) {;}
+  ~PatternFileLoader() {;}
+
+  // Fill every link buffer from the "link N" sections of the file,
+  // dropping the first offset words of each link
+  bool loadLinks(const std::string &fileName, uint32_t buffer[NILinks][NIntsPerLink], unsigned int offset = 0);
+
+  // Fill buffer with the hex words of the file in order
+  bool loadWords(const std::string &fileName, uint32_t *buffer, uint32_t maxWords);
+
+private:
+
+  bool parse(const std::string &fileName, bool linkSections);
+
+  std::string cachedName;
+  off_t cachedSize;
+  time_t cachedMTime;
+  bool cachedLinkSections;
+
+  // Link sections: NILinks x NIntsPerLink words, otherwise the flat word list
+  std::vector<uint32_t> words;
+  std::vector<uint32_t> nLinkWords;
+
+};
+
+#endif
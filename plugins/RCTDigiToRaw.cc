@@ -0,0 +1,216 @@
+// -*- C++ -*-
+//
+// Package:    TestProducer/RCTDigiToRaw
+// Class:      RCTDigiToRaw
+//
+/**\class RCTDigiToRaw RCTDigiToRaw.cc TestProducer/RCTDigiToRaw/plugins/RCTDigiToRaw.cc
+
+   Description: Packs RCT EM candidates and regions back in to CTP7 DAQ blocks
+
+   Implementation:
+   The inverse of RCTRawToDigi. The collections are turned in to RCTInfo,
+   RCTInfo in to the even and odd fiber frames, and the frames in to the
+   DAQ block by DAQSpyPacker, which is wrapped in a single AMC13 block.
+   Unpacking the output with RCTRawToDigi gives the input collections back.
+*/
+//
+
+
+// system include files
+#include <memory>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <string.h>
+
+// user include files
+#include "FWCore/Framework/interface/Frameworkfwd.h"
+#include "FWCore/Framework/interface/stream/EDProducer.h"
+
+#include "FWCore/Framework/interface/Event.h"
+#include "FWCore/Framework/interface/MakerMacros.h"
+
+#include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "FWCore/Utilities/interface/InputTag.h"
+
+#include "DataFormats/FEDRawData/interface/FEDRawData.h"
+#include "DataFormats/FEDRawData/interface/FEDRawDataCollection.h"
+
+#include "DataFormats/L1CaloTrigger/interface/L1CaloEmCand.h"
+#include "DataFormats/L1CaloTrigger/interface/L1CaloRegion.h"
+#include "DataFormats/L1CaloTrigger/interface/L1CaloCollections.h"
+
+#include "RCTInfo.hh"
+#include "DAQSpyPacker.hh"
+
+using namespace std;
+
+//
+// class declaration
+//
+
+class RCTDigiToRaw : public edm::stream::EDProducer<> {
+public:
+  explicit RCTDigiToRaw(const edm::ParameterSet&);
+  ~RCTDigiToRaw();
+
+  static void fillDescriptions(edm::ConfigurationDescriptions& descriptions);
+
+private:
+  virtual void produce(edm::Event&, const edm::EventSetup&) override;
+  void wrapAMC13(uint32_t nWords, uint32_t l1ID, uint32_t bcid, uint32_t orbit, FEDRawData &fedData) const;
+
+  // ----------member data ---------------------------
+
+  edm::EDGetTokenT<L1CaloEmCollection> emToken;
+  edm::EDGetTokenT<L1CaloRegionCollection> regionToken;
+  int fedID;
+  int amcSlot;
+  bool amc13Payload;
+  uint32_t fixedBX;
+
+  DAQSpyPacker packer;
+
+  // Reused between the events of this stream
+  std::vector<RCTInfo> rctInfo;
+  std::vector<uint32_t> block;
+
+};
+
+//
+// constants, enums and typedefs
+//
+
+// AMC13 64 bit words around the AMC payload, as RCTRawToDigi expects them
+const uint32_t AMC13HeaderWords = 2;
+const uint32_t AMC13TrailerWords = 2;
+const uint32_t AMCTrailerWords = 1;
+
+//
+// constructors and destructor
+//
+RCTDigiToRaw::RCTDigiToRaw(const edm::ParameterSet& iConfig)
+{
+  edm::InputTag input = iConfig.getUntrackedParameter<edm::InputTag>("inputLabel",edm::InputTag("rctToDigi"));
+  emToken = consumes<L1CaloEmCollection>(input);
+  regionToken = consumes<L1CaloRegionCollection>(input);
+  fedID = iConfig.getUntrackedParameter<int>("fedID",1350);
+  amcSlot = iConfig.getUntrackedParameter<int>("amcSlot",1);
+  amc13Payload = iConfig.getUntrackedParameter<bool>("amc13Payload",true);
+  //0 sizes the readout window from the highest BX in the collections
+  fixedBX = iConfig.getUntrackedParameter<unsigned int>("nBX",0);
+  packer.setFirmwareVersion(iConfig.getUntrackedParameter<unsigned int>("firmwareVersion",0));
+  packer.setCheckBytes(iConfig.getUntrackedParameter<bool>("packerCheckBytes",false));
+  //Crates go to the links of the default CTP7 or MP7 cabling
+  CrateLinkMap linkMap;
+  linkMap.setDefault(iConfig.getUntrackedParameter<bool>("mp7Mapping",false));
+  packer.setLinkMap(linkMap);
+
+  produces<FEDRawDataCollection>();
+}
+
+
+RCTDigiToRaw::~RCTDigiToRaw()
+{
+}
+
+
+//
+// member functions
+//
+
+/*
+ * Wrap the packed block as the only AMC of an AMC13 event. The block's
+ * own event header is the AMC header, so the payload starts with it.
+ * CRCs are left zero, nothing downstream of the unpacker checks them.
+ */
+
+void RCTDigiToRaw::wrapAMC13(uint32_t nWords, uint32_t l1ID, uint32_t bcid, uint32_t orbit, FEDRawData &fedData) const {
+
+  uint32_t amcSize = (nWords + 1) / 2 + AMCTrailerWords;
+  uint32_t size = AMC13HeaderWords + 1 + amcSize + AMC13TrailerWords;
+  fedData.resize(size * sizeof(uint64_t));
+  uint64_t *data = reinterpret_cast<uint64_t *>(fedData.data());
+  memset(data, 0, size * sizeof(uint64_t));
+
+  uint64_t lv1 = l1ID & 0xFFFFFF;
+  uint64_t bx = bcid & 0xFFF;
+  uint64_t slot = amcSlot & 0xF;
+  uint32_t i = 0;
+  //CDF header, AMC13 header with one AMC, and that AMC's size and flags (enabled, present, valid, CRC ok)
+  data[i++] = (0x5ULL << 60) | (0x1ULL << 56) | (lv1 << 32) | (bx << 20) | ((fedID & 0xFFF) << 8);
+  data[i++] = (0x1ULL << 60) | (0x1ULL << 52) | (uint64_t(orbit) << 4);
+  data[i++] = (0xFULL << 56) | (uint64_t(amcSize) << 32) | (slot << 16);
+  //AMC payload, headed by the block's own event header, and AMC trailer
+  memcpy(&data[i], &block[0], nWords * sizeof(uint32_t));
+  i += (nWords + 1) / 2;
+  data[i++] = ((lv1 & 0xFF) << 24) | amcSize;
+  //AMC13 and CDF trailers
+  data[i++] = ((lv1 & 0xFF) << 12) | bx;
+  data[i++] = (0xAULL << 60) | (uint64_t(size) << 32);
+}
+
+// ------------ method called to produce the data  ------------
+void
+RCTDigiToRaw::produce(edm::Event& iEvent, const edm::EventSetup& iSetup)
+{
+  using namespace edm;
+
+  std::auto_ptr<FEDRawDataCollection> rawData(new FEDRawDataCollection);
+
+  Handle<L1CaloEmCollection> emCands;
+  Handle<L1CaloRegionCollection> regions;
+  iEvent.getByToken(emToken, emCands);
+  iEvent.getByToken(regionToken, regions);
+  if(!emCands.isValid() || !regions.isValid()) {
+    cerr << "RCTDigiToRaw::produce() No RCT collections to pack" << endl;
+    iEvent.put(rawData);
+    return;
+  }
+
+  uint32_t nBX = fixedBX;
+  if(nBX == 0) {
+    nBX = 1;
+    for(uint32_t i = 0; i < emCands->size(); i++)
+      if(uint32_t((*emCands)[i].bx()) + 1 > nBX) nBX = (*emCands)[i].bx() + 1;
+    for(uint32_t i = 0; i < regions->size(); i++)
+      if(uint32_t((*regions)[i].bx()) + 1 > nBX) nBX = (*regions)[i].bx() + 1;
+  }
+  if(nBX > 0xFF) nBX = 0xFF;
+
+  if(!DAQSpyPacker::fromCollections(*emCands, *regions, nBX, rctInfo))
+    cerr << "RCTDigiToRaw::produce() Candidates outside the " << nBX << " BX window or crate slots left out" << endl;
+
+  uint32_t l1ID = iEvent.id().event();
+  block.resize(DAQSpyPacker::blockWords(nBX));
+  uint32_t nWords = packer.pack(&rctInfo[0], nBX, l1ID, iEvent.bunchCrossing(), &block[0], block.size());
+
+  FEDRawData &fedData = rawData->FEDData(fedID);
+  if(amc13Payload)
+    wrapAMC13(nWords, l1ID, iEvent.bunchCrossing(), iEvent.orbitNumber(), fedData);
+  else {
+    fedData.resize(nWords * sizeof(uint32_t));
+    memcpy(fedData.data(), &block[0], nWords * sizeof(uint32_t));
+  }
+
+  iEvent.put(rawData);
+}
+
+// ------------ method fills 'descriptions' with the allowed parameters for the module  ------------
+void
+RCTDigiToRaw::fillDescriptions(edm::ConfigurationDescriptions& descriptions) {
+  edm::ParameterSetDescription desc;
+  desc.setComment("Packs RCT EM candidates and regions in to CTP7 DAQ blocks");
+  desc.addUntracked<edm::InputTag>("inputLabel", edm::InputTag("rctToDigi"))->setComment("Module that made the L1CaloEmCollection and L1CaloRegionCollection");
+  desc.addUntracked<int>("fedID", 1350)->setComment("FED id to put the DAQ block in");
+  desc.addUntracked<int>("amcSlot", 1)->setComment("AMC13 slot number given to the CTP7");
+  desc.addUntracked<bool>("amc13Payload", true)->setComment("Wrap the DAQ block in an AMC13 payload, false for the bare block");
+  desc.addUntracked<unsigned int>("nBX", 0)->setComment("BXs in the readout window, 0 for the highest BX in the collections plus one");
+  desc.addUntracked<unsigned int>("firmwareVersion", 0)->setComment("Firmware version word of the DAQ event header");
+  desc.addUntracked<bool>("packerCheckBytes", false)->setComment("Fill a check byte in every frame, so RCTRawToDigi with verifyCheckBytes can check the packed data");
+  desc.addUntracked<bool>("mp7Mapping", false)->setComment("Place crates on the MP7 instead of the CTP7 links");
+  descriptions.addDefault(desc);
+}
+
+//define this as a plug-in
+DEFINE_FWK_MODULE(RCTDigiToRaw);
@@ -46,80 +46,7 @@ class RCTInfo {
 
     hfQBits = 0;
   }
-  RCTInfo(const RCTInfo& in) {
-    crateID = in.crateID;
-    linkIDEven = in.linkIDEven;
-    linkIDOdd  = in.linkIDOdd;
-    c1BC0 = in.c1BC0;
-    c2BC0 = in.c2BC0;
-    c3BC0 = in.c3BC0;
-    c4BC0 = in.c4BC0;
-    c5BC0 = in.c5BC0;
-    c6BC0 = in.c6BC0;
-    for(int i = 0; i < 4; i++) ieRank[i] = in.ieRank[i];
-    for(int i = 0; i < 4; i++) ieCard[i] = in.ieCard[i];
-    for(int i = 0; i < 4; i++) ieRegn[i] = in.ieRegn[i];
-    mBits = in.mBits;
-    qBits = in.qBits;
-    for(int i = 0; i < 4; i++) neRank[i] = in.neRank[i];
-    for(int i = 0; i < 4; i++) neCard[i] = in.neCard[i];
-    for(int i = 0; i < 4; i++) neRegn[i] = in.neRegn[i];
-    oBits = in.oBits;
-    tBits = in.tBits;
-    for(int i = 0; i < 2; i++) {
-      for(int j = 0; j < 4; j++) {
-	hfEt[i][j] = in.hfEt[i][j];
-      }
-    }
-    for(int i = 0; i < 7; i++) {
-      for(int j = 0; j < 2; j++) {
-	rgnEt[i][j] = in.rgnEt[i][j];
-      }
-    }
-    for(int i = 0; i < 7; i++) {
-      for(int j = 0; j < 2; j++) {
-	rgnEtTenBit[i][j] = in.rgnEtTenBit[i][j];
-      }
-    }
-    hfQBits = in.hfQBits;
-  }
-  void operator=(const RCTInfo& in) {
-    this->crateID = in.crateID;
-    this->linkIDEven = in.linkIDEven;
-    this->linkIDOdd  = in.linkIDOdd;
-    this->c1BC0 = in.c1BC0;
-    this->c2BC0 = in.c2BC0;
-    this->c3BC0 = in.c3BC0;
-    this->c4BC0 = in.c4BC0;
-    this->c5BC0 = in.c5BC0;
-    this->c6BC0 = in.c6BC0;
-    for(int i = 0; i < 4; i++) this->ieRank[i] = in.ieRank[i];
-    for(int i = 0; i < 4; i++) this->ieCard[i] = in.ieCard[i];
-    for(int i = 0; i < 4; i++) this->ieRegn[i] = in.ieRegn[i];
-    this->mBits = in.mBits;
-    this->qBits = in.qBits;
-    for(int i = 0; i < 4; i++) this->neRank[i] = in.neRank[i];
-    for(int i = 0; i < 4; i++) this->neCard[i] = in.neCard[i];
-    for(int i = 0; i < 4; i++) this->neRegn[i] = in.neRegn[i];
-    this->oBits = in.oBits;
-    this->tBits = in.tBits;
-    for(int i = 0; i < 2; i++) {
-      for(int j = 0; j < 4; j++) {
-	this->hfEt[i][j] = in.hfEt[i][j];
-      }
-    }
-    for(int i = 0; i < 7; i++) {
-      for(int j = 0; j < 2; j++) {
-	this->rgnEt[i][j] = in.rgnEt[i][j];
-      }
-    }
-    for(int i = 0; i < 7; i++) {
-      for(int j = 0; j < 2; j++) {
-	this->rgnEtTenBit[i][j] = in.rgnEtTenBit[i][j];
-      }
-    }
-    this->hfQBits = in.hfQBits;
-  }
+  // Copies are memberwise; see RCTInfoPacked for a compact form
   unsigned int crateID;
   unsigned int linkIDEven;
   unsigned int linkIDOdd; 
@@ -0,0 +1,373 @@
+#include "RCTInfoDumper.hh"
+
+#include <string.h>
+
+using namespace std;
+
+namespace {
+
+  // Large enough for the longest record, even with every field at 32 bits
+  const size_t MaxRecord = 4096;
+  const size_t BufferSize = 1 << 16;
+
+  template<size_t N> inline char *put(char *p, const char (&s)[N]) {
+    memcpy(p, s, N - 1);
+    return p + N - 1;
+  }
+
+  // At least width digits, zero padded, as setw(width) << setfill('0') << hex does.
+  // The 8 digits are spread in to the bytes of one register and 8 bytes are
+  // always stored, so there is no branch or table lookup per digit; records
+  // are written in to a reserve(MaxRecord) area, which leaves the room.
+  // Byte order is that of the little endian x86 and ARM hosts
+  inline char *putHex(char *p, uint32_t v, uint32_t width) {
+    uint64_t x = v;
+    x = ((x & 0xFFFF0000ull) << 16) | (x & 0xFFFFull);
+    x = ((x & 0x0000FF000000FF00ull) << 8) | (x & 0x000000FF000000FFull);
+    x = ((x & 0x00F000F000F000F0ull) << 4) | (x & 0x000F000F000F000Full);
+    // nibble i in byte i; '0'-'9', then 39 more for 'a'-'f'
+    uint64_t letters = ((x + 0x0606060606060606ull) >> 4) & 0x0101010101010101ull;
+    x += 0x3030303030303030ull + letters * 39;
+    x = __builtin_bswap64(x);
+    uint32_t n = (v == 0) ? 1 : (35 - __builtin_clz(v)) / 4;
+    if(n < width) n = width;
+    x >>= 8 * (8 - n);
+    memcpy(p, &x, 8);
+    return p + n;
+  }
+
+  // "00" to "99" as the two bytes of a uint16_t in memory order
+  struct DecimalPairs {
+    DecimalPairs() {
+      for(uint32_t i = 0; i < 100; i++) {
+	char digits[2] = {char('0' + i / 10), char('0' + i % 10)};
+	memcpy(&pairs[i], digits, 2);
+      }
+    }
+    uint16_t pairs[100];
+  };
+  const DecimalPairs decimalPairs;
+
+  // Decimal the same way, four digit pairs looked up in to one register, for
+  // values below 10^8; longer ones are rare enough for a loop
+  inline char *putDec(char *p, uint32_t v) {
+    if(v >= 100000000) {
+      char digits[10];
+      uint32_t n = 0;
+      do {digits[n++] = '0' + v % 10; v /= 10;} while(v != 0);
+      while(n != 0) *p++ = digits[--n];
+      return p;
+    }
+    uint32_t n = 1 + (v >= 10) + (v >= 100) + (v >= 1000) + (v >= 10000) + (v >= 100000) + (v >= 1000000) + (v >= 10000000);
+    uint32_t hi = v / 10000;
+    uint32_t lo = v % 10000;
+    uint64_t x = uint64_t(decimalPairs.pairs[hi / 100]) | (uint64_t(decimalPairs.pairs[hi % 100]) << 16) |
+      (uint64_t(decimalPairs.pairs[lo / 100]) << 32) | (uint64_t(decimalPairs.pairs[lo % 100]) << 48);
+    x >>= 8 * (8 - n);
+    memcpy(p, &x, 8);
+    return p + n;
+  }
+
+  // "(card,region,rank) "
+  inline char *putCand(char *p, uint32_t card, uint32_t regn, uint32_t rank) {
+    *p++ = '(';
+    p = putHex(p, card, 1);
+    *p++ = ',';
+    p = putHex(p, regn, 1);
+    *p++ = ',';
+    p = putHex(p, rank, 2);
+    return put(p, ") ");
+  }
+
+  // [card,region,rank]
+  inline char *jsonCand(char *p, uint32_t card, uint32_t regn, uint32_t rank) {
+    *p++ = '[';
+    p = putDec(p, card);
+    *p++ = ',';
+    p = putDec(p, regn);
+    *p++ = ',';
+    p = putDec(p, rank);
+    *p++ = ']';
+    return p;
+  }
+
+  inline char *jsonWords(char *p, const uint32_t *words) {
+    *p++ = '[';
+    for(uint32_t i = 0; i < 6; i++) {
+      if(i != 0) *p++ = ',';
+      p = put(p, "\"0x");
+      p = putHex(p, words[i], 8);
+      *p++ = '"';
+    }
+    *p++ = ']';
+    return p;
+  }
+
+  string csvHeader(bool frames) {
+    string h = "event,bx,crate,c1BC0,c2BC0,c3BC0,c4BC0,c5BC0,c6BC0";
+    const char *iso[2] = {"ie", "ne"};
+    for(uint32_t k = 0; k < 2; k++)
+      for(uint32_t j = 0; j < 4; j++) {
+	string n = to_string(j);
+	h += string(",") + iso[k] + "Card" + n + "," + iso[k] + "Regn" + n + "," + iso[k] + "Rank" + n;
+      }
+    for(uint32_t i = 0; i < 2; i++)
+      for(uint32_t j = 0; j < 4; j++)
+	h += ",hfEt" + to_string(i) + to_string(j);
+    for(uint32_t i = 0; i < 7; i++)
+      for(uint32_t j = 0; j < 2; j++)
+	h += ",rgnEt" + to_string(i) + to_string(j);
+    h += ",qBits,mBits,tBits,oBits,hfQBits";
+    if(frames) {
+      for(uint32_t i = 0; i < 6; i++) h += ",even" + to_string(i);
+      for(uint32_t i = 0; i < 6; i++) h += ",odd" + to_string(i);
+    }
+    return h + "\n";
+  }
+
+}
+
+RCTInfoDumper::RCTInfoDumper() : format(Human), dumpLevel(Objects), prescale(1), out(&cout),
+				 buffer(BufferSize), used(0), nBytes(0), nGroups(0), nInGroup(0), headerDone(false) {;}
+
+RCTInfoDumper::~RCTInfoDumper() {
+  flush();
+}
+
+bool RCTInfoDumper::parseFormat(const string &name, Format &format) {
+  if(name == "human") format = Human;
+  else if(name == "csv") format = CSV;
+  else if(name == "jsonl") format = JSONLines;
+  else return false;
+  return true;
+}
+
+void RCTInfoDumper::configure(Format f, Level l, uint32_t p) {
+  format = f;
+  dumpLevel = l;
+  prescale = (p == 0) ? 1 : p;
+  headerDone = false;
+}
+
+bool RCTInfoDumper::open(const string &fileName) {
+  flush();
+  if(file.is_open()) file.close();
+  out = &cout;
+  if(fileName.empty()) return true;
+  file.open(fileName.c_str(), ios::out | ios::trunc);
+  if(!file.is_open()) {
+    cerr << "RCTInfoDumper::open() Could not open " << fileName << ", dumping to stdout" << endl;
+    return false;
+  }
+  out = &file;
+  headerDone = false;
+  return true;
+}
+
+bool RCTInfoDumper::setup(const string &formatName, int level, uint32_t p, const string &fileName) {
+  Format f;
+  if(!parseFormat(formatName, f) || level < Off || level > Frames) {
+    cerr << "RCTInfoDumper::setup() Unknown dump format " << formatName << " or level " << level << ", not dumping" << endl;
+    configure(Human, Off, 1);
+    return false;
+  }
+  configure(f, Level(level), p);
+  return level == Off || open(fileName);
+}
+
+bool RCTInfoDumper::sample() {
+  nInGroup = 0;
+  if(dumpLevel == Off) return false;
+  return (nGroups++ % prescale) == 0;
+}
+
+char *RCTInfoDumper::reserve(size_t n) {
+  if(used + n > buffer.size()) flush();
+  if(n > buffer.size()) buffer.resize(n);
+  return buffer.data() + used;
+}
+
+void RCTInfoDumper::flush() {
+  if(used == 0) return;
+  out->write(buffer.data(), used);
+  out->flush();
+  nBytes += used;
+  used = 0;
+}
+
+void RCTInfoDumper::record(uint32_t event, uint32_t bx, uint32_t crate, const RCTInfo *rctInfo,
+			   const uint32_t *evenFrame, const uint32_t *oddFrame) {
+  if(dumpLevel == Off) return;
+  if(dumpLevel != Frames || evenFrame == 0 || oddFrame == 0) {
+    evenFrame = 0;
+    oddFrame = 0;
+    if(rctInfo == 0) return;
+  }
+
+  if(format == CSV && !headerDone) {
+    string header = csvHeader(dumpLevel == Frames);
+    memcpy(reserve(header.size()), header.data(), header.size());
+    used += header.size();
+  }
+  headerDone = true;
+
+  char *start = reserve(MaxRecord);
+  char *p = start;
+  switch(format) {
+  case Human:     p = human(p, crate, rctInfo, evenFrame, oddFrame); break;
+  case CSV:       p = csv(p, event, bx, crate, rctInfo, evenFrame, oddFrame); break;
+  case JSONLines: p = json(p, event, bx, crate, rctInfo, evenFrame, oddFrame); break;
+  }
+  used += p - start;
+  if(rctInfo != 0) nInGroup++;
+}
+
+void RCTInfoDumper::endGroup() {
+  nInGroup = 0;
+  if(dumpLevel == Off || format != Human) return;
+  char *start = reserve(8);
+  used += put(start, "Done\n") - start;
+}
+
+/*
+ * The layout of RCTInfoFactory::printRCTInfo, preceded by the raw frames
+ * as CTP7ToDigi printed them
+ */
+
+char *RCTInfoDumper::human(char *p, uint32_t crate, const RCTInfo *r, const uint32_t *even, const uint32_t *odd) {
+  if(even != 0) {
+    p = put(p, "\nCrate Number? --> ");
+    p = putDec(p, crate);
+    p = put(p, "\nPrint evenFiberData : ");
+    for(uint32_t i = 0; i < 6; i++) {p = putHex(p, even[i], 1); *p++ = ',';}
+    p = put(p, "\nPrint oddFiberData :");
+    for(uint32_t i = 0; i < 6; i++) {p = putHex(p, odd[i], 1); *p++ = ',';}
+    *p++ = '\n';
+  }
+  if(r == 0) return p;
+
+  p = put(p, "===== BC Cycle: ");
+  p = putDec(p, nInGroup);
+  p = put(p, "\nBC0/1 for Cables 1-6:             ");
+  const uint32_t bc0[6] = {r->c1BC0, r->c2BC0, r->c3BC0, r->c4BC0, r->c5BC0, r->c6BC0};
+  for(uint32_t i = 0; i < 6; i++) {
+    p = putHex(p, bc0[i], 1);
+    *p++ = (i == 5) ? '\n' : ' ';
+  }
+  p = put(p, "EISO/NISO (Card,Region,Rank) 1-4: ");
+  for(uint32_t i = 0; i < 4; i++) p = putCand(p, r->ieCard[i], r->ieRegn[i], r->ieRank[i]);
+  for(uint32_t i = 0; i < 4; i++) p = putCand(p, r->neCard[i], r->neRegn[i], r->neRank[i]);
+  p = put(p, "\nHFET[2][4]:                       ");
+  for(uint32_t i = 0; i < 2; i++)
+    for(uint32_t j = 0; j < 4; j++) {p = putHex(p, r->hfEt[i][j], 3); *p++ = ' ';}
+  p = put(p, "\nRgnET[7][2]:                      ");
+  for(uint32_t i = 0; i < 7; i++)
+    for(uint32_t j = 0; j < 2; j++) {p = putHex(p, r->rgnEt[i][j], 4); *p++ = ' ';}
+  p = put(p, "\nQ/MIP/Tau/OF/HF-Q Bits:           ");
+  const uint32_t bits[5] = {r->qBits, r->mBits, r->tBits, r->oBits, r->hfQBits};
+  for(uint32_t i = 0; i < 5; i++) {
+    p = putHex(p, bits[i], 4);
+    *p++ = (i == 4) ? '\n' : ' ';
+  }
+  return p;
+}
+
+/*
+ * One row per crate and BX, fields in decimal, frame words in hex; the
+ * RCTInfo columns are left empty for frames that did not decode
+ */
+
+char *RCTInfoDumper::csv(char *p, uint32_t event, uint32_t bx, uint32_t crate, const RCTInfo *r, const uint32_t *even, const uint32_t *odd) {
+  p = putDec(p, event);
+  *p++ = ',';
+  p = putDec(p, bx);
+  *p++ = ',';
+  p = putDec(p, crate);
+  if(r != 0) {
+    const uint32_t bc0[6] = {r->c1BC0, r->c2BC0, r->c3BC0, r->c4BC0, r->c5BC0, r->c6BC0};
+    for(uint32_t i = 0; i < 6; i++) {*p++ = ','; p = putDec(p, bc0[i]);}
+    for(uint32_t j = 0; j < 4; j++) {
+      *p++ = ','; p = putDec(p, r->ieCard[j]);
+      *p++ = ','; p = putDec(p, r->ieRegn[j]);
+      *p++ = ','; p = putDec(p, r->ieRank[j]);
+    }
+    for(uint32_t j = 0; j < 4; j++) {
+      *p++ = ','; p = putDec(p, r->neCard[j]);
+      *p++ = ','; p = putDec(p, r->neRegn[j]);
+      *p++ = ','; p = putDec(p, r->neRank[j]);
+    }
+    for(uint32_t i = 0; i < 2; i++)
+      for(uint32_t j = 0; j < 4; j++) {*p++ = ','; p = putDec(p, r->hfEt[i][j]);}
+    for(uint32_t i = 0; i < 7; i++)
+      for(uint32_t j = 0; j < 2; j++) {*p++ = ','; p = putDec(p, r->rgnEt[i][j]);}
+    const uint32_t bits[5] = {r->qBits, r->mBits, r->tBits, r->oBits, r->hfQBits};
+    for(uint32_t i = 0; i < 5; i++) {*p++ = ','; p = putDec(p, bits[i]);}
+  }
+  else {
+    // 6 BC0s, 24 candidate fields, 8 HF, 14 regions, 5 bit masks
+    for(uint32_t i = 0; i < 57; i++) *p++ = ',';
+  }
+  if(dumpLevel == Frames) {
+    for(uint32_t i = 0; i < 6; i++) {*p++ = ','; if(even != 0) {p = put(p, "0x"); p = putHex(p, even[i], 8);}}
+    for(uint32_t i = 0; i < 6; i++) {*p++ = ','; if(odd != 0) {p = put(p, "0x"); p = putHex(p, odd[i], 8);}}
+  }
+  *p++ = '\n';
+  return p;
+}
+
+/*
+ * One object per crate and BX; frames that did not decode only have
+ * event, bx, crate and the frame words
+ */
+
+char *RCTInfoDumper::json(char *p, uint32_t event, uint32_t bx, uint32_t crate, const RCTInfo *r, const uint32_t *even, const uint32_t *odd) {
+  p = put(p, "{\"event\":");
+  p = putDec(p, event);
+  p = put(p, ",\"bx\":");
+  p = putDec(p, bx);
+  p = put(p, ",\"crate\":");
+  p = putDec(p, crate);
+  if(r != 0) {
+    p = put(p, ",\"bc0\":[");
+    const uint32_t bc0[6] = {r->c1BC0, r->c2BC0, r->c3BC0, r->c4BC0, r->c5BC0, r->c6BC0};
+    for(uint32_t i = 0; i < 6; i++) {if(i != 0) *p++ = ','; p = putDec(p, bc0[i]);}
+    p = put(p, "],\"ie\":[");
+    for(uint32_t j = 0; j < 4; j++) {if(j != 0) *p++ = ','; p = jsonCand(p, r->ieCard[j], r->ieRegn[j], r->ieRank[j]);}
+    p = put(p, "],\"ne\":[");
+    for(uint32_t j = 0; j < 4; j++) {if(j != 0) *p++ = ','; p = jsonCand(p, r->neCard[j], r->neRegn[j], r->neRank[j]);}
+    p = put(p, "],\"hfEt\":[");
+    for(uint32_t i = 0; i < 2; i++) {
+      if(i != 0) *p++ = ',';
+      *p++ = '[';
+      for(uint32_t j = 0; j < 4; j++) {if(j != 0) *p++ = ','; p = putDec(p, r->hfEt[i][j]);}
+      *p++ = ']';
+    }
+    p = put(p, "],\"rgnEt\":[");
+    for(uint32_t i = 0; i < 7; i++) {
+      if(i != 0) *p++ = ',';
+      *p++ = '[';
+      p = putDec(p, r->rgnEt[i][0]);
+      *p++ = ',';
+      p = putDec(p, r->rgnEt[i][1]);
+      *p++ = ']';
+    }
+    p = put(p, "],\"qBits\":");
+    p = putDec(p, r->qBits);
+    p = put(p, ",\"mBits\":");
+    p = putDec(p, r->mBits);
+    p = put(p, ",\"tBits\":");
+    p = putDec(p, r->tBits);
+    p = put(p, ",\"oBits\":");
+    p = putDec(p, r->oBits);
+    p = put(p, ",\"hfQBits\":");
+    p = putDec(p, r->hfQBits);
+  }
+  if(even != 0) {
+    p = put(p, ",\"even\":");
+    p = jsonWords(p, even);
+    p = put(p, ",\"odd\":");
+    p = jsonWords(p, odd);
+  }
+  p = put(p, "}\n");
+  return p;
+}
@@ -0,0 +1,88 @@
+#ifndef RCTInfoDumper_hh
+#define RCTInfoDumper_hh
+
+#include <stdint.h>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "RCTInfo.hh"
+
+/*
+ * Dumps decoded crates as text: the printRCTInfo layout (Human), one CSV
+ * row or one JSON object per line (JSONLines) per crate and BX.
+ *
+ * Records are formatted by hand in to a fixed buffer, which is written to
+ * the output in one call when it fills up and on flush(), so no iostream
+ * formatting is done per field. level() picks what is dumped, and only
+ * one group (capture or event) in every prescale is dumped at all.
+ */
+
+class RCTInfoDumper {
+
+public:
+
+  enum Format {Human = 0, CSV, JSONLines};
+  enum Level {Off = 0, Objects, Frames};   // Frames adds the raw fiber words
+
+  RCTInfoDumper();
+  ~RCTInfoDumper();
+
+  // "human", "csv" or "jsonl"; false for anything else
+  static bool parseFormat(const std::string &name, Format &format);
+
+  void configure(Format format, Level level, uint32_t prescale);
+
+  // Write to fileName, or to std::cout if it is empty
+  bool open(const std::string &fileName);
+
+  // configure() and open() from module parameters; an unknown format or level is reported and dumps nothing
+  bool setup(const std::string &formatName, int level, uint32_t prescale, const std::string &fileName);
+
+  Level level() const {return dumpLevel;}
+
+  // Start the next capture or event; true if it is one to dump
+  bool sample();
+
+  // One crate of one BX; the frames are only dumped at level Frames,
+  // and a null rctInfo (frames that did not decode) dumps the frames alone
+  void record(uint32_t event, uint32_t bx, uint32_t crate, const RCTInfo *rctInfo,
+	      const uint32_t *evenFrame = 0, const uint32_t *oddFrame = 0);
+
+  // End of a group of records (a BX), "Done" in the Human format
+  void endGroup();
+
+  void flush();
+
+  uint64_t bytesWritten() const {return nBytes;}
+
+private:
+
+  RCTInfoDumper(const RCTInfoDumper&);
+  const RCTInfoDumper& operator=(const RCTInfoDumper&);
+
+  // Room for n more characters, flushing first if needed
+  char *reserve(size_t n);
+
+  char *human(char *p, uint32_t crate, const RCTInfo *r, const uint32_t *even, const uint32_t *odd);
+  char *csv(char *p, uint32_t event, uint32_t bx, uint32_t crate, const RCTInfo *r, const uint32_t *even, const uint32_t *odd);
+  char *json(char *p, uint32_t event, uint32_t bx, uint32_t crate, const RCTInfo *r, const uint32_t *even, const uint32_t *odd);
+
+  Format format;
+  Level dumpLevel;
+  uint32_t prescale;
+
+  std::ostream *out;
+  std::ofstream file;
+  std::vector<char> buffer;
+  size_t used;
+  uint64_t nBytes;
+
+  uint64_t nGroups;
+  uint32_t nInGroup;
+  bool headerDone;
+
+};
+
+#endif
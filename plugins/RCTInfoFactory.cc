@@ -14,6 +14,8 @@ using namespace std;
 #include "RCTInfo.hh"
 
 #include "RCTInfoFactory.hh"
+#include "FrameCheckByte.hh"
+#include "RCTInfoDumper.hh"
 
 /*
  * This class contains tools to take bit information and extract object information
@@ -63,141 +65,269 @@ bool RCTInfoFactory::setRCTInfoCrateID(std::vector<RCTInfo> &rctInfoVector, unsi
  * Primarily intended for use on CTP7/MP7
  */
 
-bool RCTInfoFactory::produce(const std::vector <unsigned int> evenFiberData, 
-			     const std::vector <unsigned int> oddFiberData,
+bool RCTInfoFactory::produce(const std::vector <unsigned int> &evenFiberData, 
+			     const std::vector <unsigned int> &oddFiberData,
 			     std::vector <RCTInfo> &rctInfoData) {
-  static int nPrintOuts = 0;
-  // Ensure that there is data to process
-  unsigned int nWordsToProcess = evenFiberData.size();
-  unsigned int remainder = nWordsToProcess%6;
-  if(nWordsToProcess != oddFiberData.size()) {
+  if(evenFiberData.size() != oddFiberData.size()) {
     std::cerr << "RCTInfoFactory::produce -- even and odd fiber sizes are different!" << std::endl;
     return false;
   }
-  if(nWordsToProcess == 0|| nWordsToProcess/6 == 0) {
+  return produce(evenFiberData.data(), oddFiberData.data(), evenFiberData.size(), rctInfoData);
+}
+
+bool RCTInfoFactory::produce(const unsigned int *evenFiberData, 
+			     const unsigned int *oddFiberData,
+			     unsigned int nWords,
+			     std::vector <RCTInfo> &rctInfoData) {
+  // Ensure that there is data to process
+  if(nWords/6 == 0) {
     std::cerr << "RCTInfoFactory::produce -- evenFiberData is null :(" << std::endl;
     return false;
   }
-  else if((nWordsToProcess % 6) != 0) {
-    nWordsToProcess=nWordsToProcess-remainder;
+
+  // Extract RCTInfo in place, after what the vector already holds
+  unsigned int nBXToProcess = nWords / 6;
+  unsigned int first = rctInfoData.size();
+  rctInfoData.resize(first + nBXToProcess);
+  std::vector<unsigned char> status(nBXToProcess);
+  produce(FiberSpan(evenFiberData, nWords), FiberSpan(oddFiberData, nWords), &rctInfoData[first], &status[0], nBXToProcess);
+  for(unsigned int iBX = 0; iBX < nBXToProcess; iBX++) {
+    if(status[iBX] == FRAME_BAD_BX_BYTE) {
+      rctInfoData.clear();
+      return false;
+    }
   }
+  return true;
 
-  // Extract RCTInfo
+}
 
-  unsigned int nBXToProcess = nWordsToProcess / 6;
+unsigned int RCTInfoFactory::produce(const FiberSpan &evenFiber,
+				     const FiberSpan &oddFiber,
+				     RCTInfo *rctInfo,
+				     unsigned char *status,
+				     unsigned int capacity) {
+  unsigned int nBX = evenFiber.nBX < oddFiber.nBX ? evenFiber.nBX : oddFiber.nBX;
+  if(nBX > capacity)
+    nBX = capacity;
+  for(unsigned int iBX = 0; iBX < nBX; iBX++) {
+    rctInfo[iBX] = RCTInfo();
+    status[iBX] = decodeFrameStatus(evenFiber.frame(iBX), oddFiber.frame(iBX), iBX, rctInfo[iBX]);
+  }
+  return nBX;
+}
 
-  for(unsigned int iBX = 0; iBX < nBXToProcess; iBX++) {
-    // Check hamming codes for data -- nevertheless continue
-    if(!verifyHammingCode((unsigned char *) &evenFiberData[iBX * 6])) {
-      std::cerr << "Hamming code failed for even fiber for bunch crossing" << iBX << std::endl;
-    }
-    if(!verifyHammingCode((unsigned char *) &oddFiberData[iBX * 6])) {
-      std::cerr << "Hamming code failed for odd fiber for bunch crossing" << iBX << std::endl;
-    }
+/*
+ * Same, keeping the frames as they are; fields are decoded when read
+ */
 
-    RCTInfo rctInfo;
-    if(inAbortGap( evenFiberData[iBX * 6 ], oddFiberData[iBX * 6 ])) {
-      if(nPrintOuts<10)
-	std::cout<<"First word is 0x505050BC. Appears we are in the Abort Gap. Skipping."<<std::endl;
-      nPrintOuts++;
-      rctInfoData.push_back(rctInfo);
-      continue;
+unsigned int RCTInfoFactory::produce(const FiberSpan &evenFiber,
+				     const FiberSpan &oddFiber,
+				     RCTInfoPacked *rctInfo,
+				     unsigned char *status,
+				     unsigned int capacity) {
+  unsigned int nBX = evenFiber.nBX < oddFiber.nBX ? evenFiber.nBX : oddFiber.nBX;
+  if(nBX > capacity)
+    nBX = capacity;
+  for(unsigned int iBX = 0; iBX < nBX; iBX++) {
+    status[iBX] = checkFrame(evenFiber.frame(iBX), oddFiber.frame(iBX), iBX);
+    if(status[iBX] == FRAME_OK) {
+      rctInfo[iBX].set(evenFiber.frame(iBX), oddFiber.frame(iBX));
+      if(checkByteCheck)
+	status[iBX] = verifyCheckBytes(rctInfo[iBX].evenFiber(), rctInfo[iBX].oddFiber(), iBX);
+      checkBC0(rctInfo[iBX].evenFiber(), rctInfo[iBX].oddFiber(), iBX);
     }
+    else
+      rctInfo[iBX] = RCTInfoPacked();
+  }
+  return nBX;
+}
 
-    if(!verifyBXBytes( evenFiberData[iBX * 6 ], oddFiberData[iBX * 6 ])) {
-      std::cerr << "Error BX Byte is not 0x7C or 0x3C --- Discarding this capture!! " <<std::hex<< evenFiberData[iBX * 6 ] << " " << oddFiberData[iBX * 6 ] << std::endl;
-      std::cerr << "Possibly this is due to a single dropped packet or something worse is wrong"<< std::endl;
-      rctInfoData.clear();
-      return false;
-    }
-    //RCTInfo rctInfo;
-    // We extract into rctInfo the data from RCT crate
-    // Bit field description can be found in the spreadsheet:
-    // https://twiki.cern.ch/twiki/pub/CMS/ORSCOperations/oRSCFiberDataSpecificationV5.xlsx
-    // Even fiber bits contain 4x4 region information
-    rctInfo.rgnEt[0][0]  = (evenFiberData[iBX * 6 + 0] & 0x0003FF00) >>  8;
-    rctInfo.rgnEt[0][1]  = (evenFiberData[iBX * 6 + 0] & 0x0FFC0000) >> 18;
-    rctInfo.rgnEt[1][0]  = (evenFiberData[iBX * 6 + 0] & 0xF0000000) >> 28;
-    rctInfo.rgnEt[1][0] |= (evenFiberData[iBX * 6 + 1] & 0x0000003F) <<  4;
-    rctInfo.rgnEt[1][1]  = (evenFiberData[iBX * 6 + 1] & 0x0000FFC0) >>  6;
-    rctInfo.rgnEt[2][0]  = (evenFiberData[iBX * 6 + 1] & 0x03FF0000) >> 16;
-    rctInfo.rgnEt[2][1]  = (evenFiberData[iBX * 6 + 1] & 0xFC000000) >> 26;
-    rctInfo.rgnEt[2][1] |= (evenFiberData[iBX * 6 + 2] & 0x0000000F) <<  6;
-    rctInfo.rgnEt[3][0]  = (evenFiberData[iBX * 6 + 2] & 0x00003FF0) >>  4;
-    rctInfo.rgnEt[3][1]  = (evenFiberData[iBX * 6 + 2] & 0x00FFC000) >> 14;
-    rctInfo.rgnEt[4][0]  = (evenFiberData[iBX * 6 + 2] & 0xFF000000) >> 24;
-    rctInfo.rgnEt[4][0] |= (evenFiberData[iBX * 6 + 3] & 0x00000003) <<  8;
-    rctInfo.rgnEt[4][1]  = (evenFiberData[iBX * 6 + 3] & 0x00000FFC) >>  2;
-    rctInfo.rgnEt[5][0]  = (evenFiberData[iBX * 6 + 3] & 0x003FF000) >> 12;
-    rctInfo.rgnEt[5][1]  = (evenFiberData[iBX * 6 + 3] & 0xFFC00000) >> 22;
-    rctInfo.rgnEt[6][0]  = (evenFiberData[iBX * 6 + 4] & 0x000003FF) >>  0;
-    rctInfo.rgnEt[6][1]  = (evenFiberData[iBX * 6 + 4] & 0x000FFC00) >> 10;
-    rctInfo.tBits  = (evenFiberData[iBX * 6 + 4] & 0xFFF00000) >> 20;
-    rctInfo.tBits |= (evenFiberData[iBX * 6 + 5] & 0x00000003) << 12; //bug? 4 to 5
-    rctInfo.oBits  = (evenFiberData[iBX * 6 + 5] & 0x0000FFFC) >>  2;
-    rctInfo.c4BC0  = (evenFiberData[iBX * 6 + 5] & 0x000C0000) >> 18;
-    rctInfo.c5BC0  = (evenFiberData[iBX * 6 + 5] & 0x00300000) >> 20;
-    rctInfo.c6BC0  = (evenFiberData[iBX * 6 + 5] & 0x00C00000) >> 22;
-    // Odd fiber bits contain 2x1, HF and other miscellaneous information
-    rctInfo.hfEt[0][0]  = (oddFiberData[iBX * 6 + 0] & 0x0000FF00) >>  8;
-    rctInfo.hfEt[0][1]  = (oddFiberData[iBX * 6 + 0] & 0x00FF0000) >> 16;
-    rctInfo.hfEt[1][0]  = (oddFiberData[iBX * 6 + 0] & 0xFF000000) >> 24;
-    rctInfo.hfEt[1][1]  = (oddFiberData[iBX * 6 + 1] & 0x000000FF) >>  0;
-    rctInfo.hfEt[0][2]  = (oddFiberData[iBX * 6 + 1] & 0x0000FF00) >>  8;
-    rctInfo.hfEt[0][3]  = (oddFiberData[iBX * 6 + 1] & 0x00FF0000) >> 16;
-    rctInfo.hfEt[1][2]  = (oddFiberData[iBX * 6 + 1] & 0xFF000000) >> 24;
-    rctInfo.hfEt[1][3]  = (oddFiberData[iBX * 6 + 2] & 0x000000FF) >>  0;
-    rctInfo.hfQBits     = (oddFiberData[iBX * 6 + 2] & 0x0000FF00) >>  8;
-    rctInfo.ieRank[0]   = (oddFiberData[iBX * 6 + 2] & 0x003F0000) >> 16;
-    rctInfo.ieRegn[0]   = (oddFiberData[iBX * 6 + 2] & 0x00400000) >> 22;
-    rctInfo.ieCard[0]   = (oddFiberData[iBX * 6 + 2] & 0x03800000) >> 23; //bug? 25 to 23
-    rctInfo.ieRank[1]   = (oddFiberData[iBX * 6 + 2] & 0xFC000000) >> 26;
-    rctInfo.ieRegn[1]   = (oddFiberData[iBX * 6 + 3] & 0x00000001) >>  0;
-    rctInfo.ieCard[1]   = (oddFiberData[iBX * 6 + 3] & 0x0000000E) >>  1;
-    rctInfo.ieRank[2]   = (oddFiberData[iBX * 6 + 3] & 0x000003F0) >>  4;
-    rctInfo.ieRegn[2]   = (oddFiberData[iBX * 6 + 3] & 0x00000400) >> 10;
-    rctInfo.ieCard[2]   = (oddFiberData[iBX * 6 + 3] & 0x00003800) >> 11;
-    rctInfo.ieRank[3]   = (oddFiberData[iBX * 6 + 3] & 0x000FC000) >> 14;
-    rctInfo.ieRegn[3]   = (oddFiberData[iBX * 6 + 3] & 0x00100000) >> 20;
-    rctInfo.ieCard[3]   = (oddFiberData[iBX * 6 + 3] & 0x00E00000) >> 21;
-    rctInfo.neRank[0]   = (oddFiberData[iBX * 6 + 3] & 0x3F000000) >> 24; 
-    rctInfo.neRegn[0]   = (oddFiberData[iBX * 6 + 3] & 0x40000000) >> 30;
-    rctInfo.neCard[0]   = (oddFiberData[iBX * 6 + 3] & 0x80000000) >> 31; 
-    rctInfo.neCard[0]  |= (oddFiberData[iBX * 6 + 4] & 0x00000003) <<  1; //bug? >> 0 to << 1
-    rctInfo.neRank[1]   = (oddFiberData[iBX * 6 + 4] & 0x000000FC) >>  2;
-    rctInfo.neRegn[1]   = (oddFiberData[iBX * 6 + 4] & 0x00000100) >>  8;
-    rctInfo.neCard[1]   = (oddFiberData[iBX * 6 + 4] & 0x00000E00) >>  9;
-    rctInfo.neRank[2]   = (oddFiberData[iBX * 6 + 4] & 0x0003F000) >> 12;
-    rctInfo.neRegn[2]   = (oddFiberData[iBX * 6 + 4] & 0x00040000) >> 18;
-    rctInfo.neCard[2]   = (oddFiberData[iBX * 6 + 4] & 0x00380000) >> 19;
-    rctInfo.neRank[3]   = (oddFiberData[iBX * 6 + 4] & 0x0FC00000) >> 22;
-    rctInfo.neRegn[3]   = (oddFiberData[iBX * 6 + 4] & 0x10000000) >> 28;
-    rctInfo.neCard[3]   = (oddFiberData[iBX * 6 + 4] & 0xE0000000) >> 29;
-    rctInfo.mBits       = (oddFiberData[iBX * 6 + 5] & 0x00003FFF) >>  0;
-    rctInfo.c1BC0       = (oddFiberData[iBX * 6 + 5] & 0x00030000) >> 16;
-    rctInfo.c2BC0       = (oddFiberData[iBX * 6 + 5] & 0x000C0000) >> 18;
-    rctInfo.c3BC0       = (oddFiberData[iBX * 6 + 5] & 0x00300000) >> 20;
-    unsigned int oddFiberc4BC0 = (oddFiberData[iBX * 6 + 5] & 0x00C00000) >> 22;
-    if(oddFiberc4BC0 != rctInfo.c4BC0) {
-      std::cerr << "Even and odd fibers do not agree on cable 4 BC0 mark :(" << std::endl;
-    }
+/*
+ * Abort gap and BX byte checks of one BX; failures are counted in errorStats()
+ */
 
-    //Adding in extra function to make comparison of the region tau and overflow bits easier
-    for(int i = 0; i < 7; i++) 
-      for(int j = 0; j < 2; j++) 
-	rctInfo.rgnEtTenBit[i][j] = GetRegTenBits(rctInfo, i, j);
+RCTInfoFactory::FrameStatus RCTInfoFactory::checkFrame(const unsigned int *evenFiber, 
+						       const unsigned int *oddFiber,
+						       unsigned int iBX) {
+  if(inAbortGap( evenFiber[0], oddFiber[0])) {
+    errors->add(RCTFrameErrors::AbortGap, evenLink, firstBX + iBX, evenFiber[0]);
+    return FRAME_ABORT_GAP;
+  }
 
-    for(int j = 0; j <4; j++){
-      rctInfo.ieTenBit[j] = GetElectronTenBits( rctInfo.ieCard[j] , rctInfo.ieRegn[j] , rctInfo.ieRank[j] );
-      rctInfo.neTenBit[j] = GetElectronTenBits( rctInfo.neCard[j] , rctInfo.neRegn[j] , rctInfo.neRank[j] );
-    }
+  //Possibly this is due to a single dropped packet or something worse is wrong
+  if(!verifyBXBytes( evenFiber[0], oddFiber[0], iBX))
+    return FRAME_BAD_BX_BYTE;
+  return FRAME_OK;
+}
+
+/*
+ * Both fibers carry the cable 4 BC0 mark; count it if they disagree
+ */
+
+void RCTInfoFactory::checkBC0(const unsigned int *evenFiber, 
+			      const unsigned int *oddFiber,
+			      unsigned int iBX) {
+  if(((evenFiber[5] >> 18) & 0x3) != ((oddFiber[5] >> 22) & 0x3))
+    errors->add(RCTFrameErrors::BC0Mismatch, evenLink, firstBX + iBX, (evenFiber[5] & 0xFFFF0000) | (oddFiber[5] >> 16));
+}
+
+/*
+ * Check the packer's check bytes of a BX; the frames are only read,
+ * a mismatch means the packer or the chain after it is broken
+ */
 
-    rctInfoData.push_back(rctInfo);
+RCTInfoFactory::FrameStatus RCTInfoFactory::verifyCheckBytes(const unsigned int *evenFiber, 
+							     const unsigned int *oddFiber,
+							     unsigned int iBX) {
+  uint8_t evenSyndrome = FrameCheckByte::syndrome(evenFiber);
+  uint8_t oddSyndrome = FrameCheckByte::syndrome(oddFiber);
+  if(evenSyndrome != 0)
+    errors->add(RCTFrameErrors::BadCheckByte, evenLink, firstBX + iBX, evenSyndrome);
+  if(oddSyndrome != 0)
+    errors->add(RCTFrameErrors::BadCheckByte, oddLink, firstBX + iBX, oddSyndrome);
+  return (evenSyndrome | oddSyndrome) == 0 ? FRAME_OK : FRAME_BAD_CHECK_BYTE;
+}
+
+/*
+ * Decode one BX from the 6-word frames of the even and odd fibers
+ * Safe to call concurrently; rctInfo is left untouched for abort gap frames
+ */
+
+RCTInfoFactory::FrameStatus RCTInfoFactory::decodeFrameStatus(const unsigned int *evenFiber, 
+							     const unsigned int *oddFiber,
+							     unsigned int iBX,
+							     RCTInfo &rctInfo) {
+  FrameStatus status = checkFrame(evenFiber, oddFiber, iBX);
+  if(status != FRAME_OK)
+    return status;
+
+  if(checkByteCheck)
+    status = verifyCheckBytes(evenFiber, oddFiber, iBX);
+  checkBC0(evenFiber, oddFiber, iBX);
+  //RCTInfo rctInfo;
+  // We extract into rctInfo the data from RCT crate
+  // Bit field description can be found in the spreadsheet:
+  // https://twiki.cern.ch/twiki/pub/CMS/ORSCOperations/oRSCFiberDataSpecificationV5.xlsx
+  // Even fiber bits contain 4x4 region information
+  rctInfo.rgnEt[0][0]  = (evenFiber[0] & 0x0003FF00) >>  8;
+  rctInfo.rgnEt[0][1]  = (evenFiber[0] & 0x0FFC0000) >> 18;
+  rctInfo.rgnEt[1][0]  = (evenFiber[0] & 0xF0000000) >> 28;
+  rctInfo.rgnEt[1][0] |= (evenFiber[1] & 0x0000003F) <<  4;
+  rctInfo.rgnEt[1][1]  = (evenFiber[1] & 0x0000FFC0) >>  6;
+  rctInfo.rgnEt[2][0]  = (evenFiber[1] & 0x03FF0000) >> 16;
+  rctInfo.rgnEt[2][1]  = (evenFiber[1] & 0xFC000000) >> 26;
+  rctInfo.rgnEt[2][1] |= (evenFiber[2] & 0x0000000F) <<  6;
+  rctInfo.rgnEt[3][0]  = (evenFiber[2] & 0x00003FF0) >>  4;
+  rctInfo.rgnEt[3][1]  = (evenFiber[2] & 0x00FFC000) >> 14;
+  rctInfo.rgnEt[4][0]  = (evenFiber[2] & 0xFF000000) >> 24;
+  rctInfo.rgnEt[4][0] |= (evenFiber[3] & 0x00000003) <<  8;
+  rctInfo.rgnEt[4][1]  = (evenFiber[3] & 0x00000FFC) >>  2;
+  rctInfo.rgnEt[5][0]  = (evenFiber[3] & 0x003FF000) >> 12;
+  rctInfo.rgnEt[5][1]  = (evenFiber[3] & 0xFFC00000) >> 22;
+  rctInfo.rgnEt[6][0]  = (evenFiber[4] & 0x000003FF) >>  0;
+  rctInfo.rgnEt[6][1]  = (evenFiber[4] & 0x000FFC00) >> 10;
+  rctInfo.tBits  = (evenFiber[4] & 0xFFF00000) >> 20;
+  rctInfo.tBits |= (evenFiber[5] & 0x00000003) << 12; //bug? 4 to 5
+  rctInfo.oBits  = (evenFiber[5] & 0x0000FFFC) >>  2;
+  rctInfo.c4BC0  = (evenFiber[5] & 0x000C0000) >> 18;
+  rctInfo.c5BC0  = (evenFiber[5] & 0x00300000) >> 20;
+  rctInfo.c6BC0  = (evenFiber[5] & 0x00C00000) >> 22;
+  // Odd fiber bits contain 2x1, HF and other miscellaneous information
+  rctInfo.hfEt[0][0]  = (oddFiber[0] & 0x0000FF00) >>  8;
+  rctInfo.hfEt[0][1]  = (oddFiber[0] & 0x00FF0000) >> 16;
+  rctInfo.hfEt[1][0]  = (oddFiber[0] & 0xFF000000) >> 24;
+  rctInfo.hfEt[1][1]  = (oddFiber[1] & 0x000000FF) >>  0;
+  rctInfo.hfEt[0][2]  = (oddFiber[1] & 0x0000FF00) >>  8;
+  rctInfo.hfEt[0][3]  = (oddFiber[1] & 0x00FF0000) >> 16;
+  rctInfo.hfEt[1][2]  = (oddFiber[1] & 0xFF000000) >> 24;
+  rctInfo.hfEt[1][3]  = (oddFiber[2] & 0x000000FF) >>  0;
+  rctInfo.hfQBits     = (oddFiber[2] & 0x0000FF00) >>  8;
+  rctInfo.ieRank[0]   = (oddFiber[2] & 0x003F0000) >> 16;
+  rctInfo.ieRegn[0]   = (oddFiber[2] & 0x00400000) >> 22;
+  rctInfo.ieCard[0]   = (oddFiber[2] & 0x03800000) >> 23; //bug? 25 to 23
+  rctInfo.ieRank[1]   = (oddFiber[2] & 0xFC000000) >> 26;
+  rctInfo.ieRegn[1]   = (oddFiber[3] & 0x00000001) >>  0;
+  rctInfo.ieCard[1]   = (oddFiber[3] & 0x0000000E) >>  1;
+  rctInfo.ieRank[2]   = (oddFiber[3] & 0x000003F0) >>  4;
+  rctInfo.ieRegn[2]   = (oddFiber[3] & 0x00000400) >> 10;
+  rctInfo.ieCard[2]   = (oddFiber[3] & 0x00003800) >> 11;
+  rctInfo.ieRank[3]   = (oddFiber[3] & 0x000FC000) >> 14;
+  rctInfo.ieRegn[3]   = (oddFiber[3] & 0x00100000) >> 20;
+  rctInfo.ieCard[3]   = (oddFiber[3] & 0x00E00000) >> 21;
+  rctInfo.neRank[0]   = (oddFiber[3] & 0x3F000000) >> 24; 
+  rctInfo.neRegn[0]   = (oddFiber[3] & 0x40000000) >> 30;
+  rctInfo.neCard[0]   = (oddFiber[3] & 0x80000000) >> 31; 
+  rctInfo.neCard[0]  |= (oddFiber[4] & 0x00000003) <<  1; //bug? >> 0 to << 1
+  rctInfo.neRank[1]   = (oddFiber[4] & 0x000000FC) >>  2;
+  rctInfo.neRegn[1]   = (oddFiber[4] & 0x00000100) >>  8;
+  rctInfo.neCard[1]   = (oddFiber[4] & 0x00000E00) >>  9;
+  rctInfo.neRank[2]   = (oddFiber[4] & 0x0003F000) >> 12;
+  rctInfo.neRegn[2]   = (oddFiber[4] & 0x00040000) >> 18;
+  rctInfo.neCard[2]   = (oddFiber[4] & 0x00380000) >> 19;
+  rctInfo.neRank[3]   = (oddFiber[4] & 0x0FC00000) >> 22;
+  rctInfo.neRegn[3]   = (oddFiber[4] & 0x10000000) >> 28;
+  rctInfo.neCard[3]   = (oddFiber[4] & 0xE0000000) >> 29;
+  rctInfo.mBits       = (oddFiber[5] & 0x00003FFF) >>  0;
+  rctInfo.c1BC0       = (oddFiber[5] & 0x00030000) >> 16;
+  rctInfo.c2BC0       = (oddFiber[5] & 0x000C0000) >> 18;
+  rctInfo.c3BC0       = (oddFiber[5] & 0x00300000) >> 20;
+
+  //Adding in extra function to make comparison of the region tau and overflow bits easier
+  for(int i = 0; i < 7; i++) 
+    for(int j = 0; j < 2; j++) 
+	rctInfo.rgnEtTenBit[i][j] = GetRegTenBits(rctInfo, i, j);
+
+  for(int j = 0; j <4; j++){
+    rctInfo.ieTenBit[j] = GetElectronTenBits( rctInfo.ieCard[j] , rctInfo.ieRegn[j] , rctInfo.ieRank[j] );
+    rctInfo.neTenBit[j] = GetElectronTenBits( rctInfo.neCard[j] , rctInfo.neRegn[j] , rctInfo.neRank[j] );
   }
-  return true;
+
+  return status;
 
 }
 
+/*
+ * Inverse of decodeFrame: the 6-word frames of the even and odd fibers
+ * for one BX. Fields are cut to their width in the fiber format.
+ */
+
+static inline unsigned int bitField(unsigned int value, unsigned int nBits, unsigned int shift) {
+  return (value & ((1u << nBits) - 1)) << shift;
+}
+
+void RCTInfoFactory::encodeFrame(const RCTInfo &rctInfo,
+				 unsigned int *evenFiber,
+				 unsigned int *oddFiber,
+				 unsigned int bxByte) {
+  const RCTInfo &r = rctInfo;
+  evenFiber[0] = bitField(bxByte, 8, 0) | bitField(r.rgnEt[0][0], 10, 8) | bitField(r.rgnEt[0][1], 10, 18) |
+    bitField(r.rgnEt[1][0], 4, 28);
+  evenFiber[1] = bitField(r.rgnEt[1][0] >> 4, 6, 0) | bitField(r.rgnEt[1][1], 10, 6) | bitField(r.rgnEt[2][0], 10, 16) |
+    bitField(r.rgnEt[2][1], 6, 26);
+  evenFiber[2] = bitField(r.rgnEt[2][1] >> 6, 4, 0) | bitField(r.rgnEt[3][0], 10, 4) | bitField(r.rgnEt[3][1], 10, 14) |
+    bitField(r.rgnEt[4][0], 8, 24);
+  evenFiber[3] = bitField(r.rgnEt[4][0] >> 8, 2, 0) | bitField(r.rgnEt[4][1], 10, 2) | bitField(r.rgnEt[5][0], 10, 12) |
+    bitField(r.rgnEt[5][1], 10, 22);
+  evenFiber[4] = bitField(r.rgnEt[6][0], 10, 0) | bitField(r.rgnEt[6][1], 10, 10) | bitField(r.tBits, 12, 20);
+  evenFiber[5] = bitField(r.tBits >> 12, 2, 0) | bitField(r.oBits, 14, 2) |
+    bitField(r.c4BC0, 2, 18) | bitField(r.c5BC0, 2, 20) | bitField(r.c6BC0, 2, 22);
+
+  oddFiber[0] = bitField(bxByte, 8, 0) | bitField(r.hfEt[0][0], 8, 8) | bitField(r.hfEt[0][1], 8, 16) | bitField(r.hfEt[1][0], 8, 24);
+  oddFiber[1] = bitField(r.hfEt[1][1], 8, 0) | bitField(r.hfEt[0][2], 8, 8) | bitField(r.hfEt[0][3], 8, 16) | bitField(r.hfEt[1][2], 8, 24);
+  oddFiber[2] = bitField(r.hfEt[1][3], 8, 0) | bitField(r.hfQBits, 8, 8) |
+    bitField(r.ieRank[0], 6, 16) | bitField(r.ieRegn[0], 1, 22) | bitField(r.ieCard[0], 3, 23) | bitField(r.ieRank[1], 6, 26);
+  oddFiber[3] = bitField(r.ieRegn[1], 1, 0) | bitField(r.ieCard[1], 3, 1) |
+    bitField(r.ieRank[2], 6, 4) | bitField(r.ieRegn[2], 1, 10) | bitField(r.ieCard[2], 3, 11) |
+    bitField(r.ieRank[3], 6, 14) | bitField(r.ieRegn[3], 1, 20) | bitField(r.ieCard[3], 3, 21) |
+    bitField(r.neRank[0], 6, 24) | bitField(r.neRegn[0], 1, 30) | bitField(r.neCard[0], 1, 31);
+  oddFiber[4] = bitField(r.neCard[0] >> 1, 2, 0) |
+    bitField(r.neRank[1], 6, 2) | bitField(r.neRegn[1], 1, 8) | bitField(r.neCard[1], 3, 9) |
+    bitField(r.neRank[2], 6, 12) | bitField(r.neRegn[2], 1, 18) | bitField(r.neCard[2], 3, 19) |
+    bitField(r.neRank[3], 6, 22) | bitField(r.neRegn[3], 1, 28) | bitField(r.neCard[3], 3, 29);
+  oddFiber[5] = bitField(r.mBits, 14, 0) | bitField(r.c1BC0, 2, 16) | bitField(r.c2BC0, 2, 18) |
+    bitField(r.c3BC0, 2, 20) | bitField(r.c4BC0, 2, 22);
+}
+
 unsigned int RCTInfoFactory::GetElectronTenBits(unsigned int Card, unsigned int Region, unsigned int Rank)
 {
 /* 
@@ -238,11 +368,26 @@ unsigned int RCTInfoFactory::GetRegTenBits(RCTInfo rctInfo, unsigned int j, unsi
 
 /*
  * Extract RCT Object Info from oRSC Capture RAMS
- * Takes as input 5 raw cable data in the form of a vector
- * Intended for use with oRSC Capture RAMs
+ * Takes as input the 6 raw cable data in the form of a vector
+ * Intended for use with oRSC Capture RAMs; CableDecoder is the bulk version
+ * and this stays as its scalar reference
  */
 
-bool RCTInfoFactory::produce(const std::vector < std::vector < unsigned int > > rawCableData, std::vector< RCTInfo > &rctInfoData) {
+bool RCTInfoFactory::produce(const std::vector < std::vector < unsigned int > > &rawCableData, std::vector< RCTInfo > &rctInfoData) {
+  if(rawCableData.size() != 6) {
+    std::cerr << "RCTInfoFactory::produce -- " << rawCableData.size() << " cables instead of 6" << std::endl;
+    return false;
+  }
+  for(unsigned int cable = 1; cable < 6; cable++) {
+    if(rawCableData[cable].size() != rawCableData[0].size()) {
+      std::cerr << "RCTInfoFactory::produce -- cable sizes are different!" << std::endl;
+      return false;
+    }
+  }
+  if(rawCableData[0].size() % 2 != 0) {
+    std::cerr << "RCTInfoFactory::produce -- odd number of cable words" << std::endl;
+    return false;
+  }
   const unsigned int *ieArray = rawCableData[0].data();  // [i] - cycle 0, [i+1] - cycle 1 of 80 MHz Clock
   const unsigned int *neArray = rawCableData[1].data();  // [i] - cycle 0, [i+1] - cycle 1 of 80 MHz Clock
   const unsigned int *j3Array = rawCableData[2].data();  // [i] - cycle 0, [i+1] - cycle 1 of 80 MHz Clock
@@ -365,46 +510,18 @@ bool RCTInfoFactory::produce(const std::vector < std::vector < unsigned int > >
  */
 
 bool RCTInfoFactory::printRCTInfo(const std::vector<RCTInfo> &rctInfo){
+  return printRCTInfo(rctInfo.data(), rctInfo.size());
+}
 
-  for(unsigned int iBC = 0; iBC < rctInfo.size(); iBC++) {
-    cout <<dec<< "===== BC Cycle: "<< iBC <<endl;
-    cout << "BC0/1 for Cables 1-6:             ";
-    cout << hex << setfill('0') << setw(1) << rctInfo[iBC].c1BC0 << " ";
-    cout << hex << setfill('0') << setw(1) << rctInfo[iBC].c2BC0 << " ";
-    cout << hex << setfill('0') << setw(1) << rctInfo[iBC].c3BC0 << " ";
-    cout << hex << setfill('0') << setw(1) << rctInfo[iBC].c4BC0 << " ";
-    cout << hex << setfill('0') << setw(1) << rctInfo[iBC].c5BC0 << " ";
-    cout << hex << setfill('0') << setw(1) << rctInfo[iBC].c6BC0 << endl;
-    cout << "EISO/NISO (Card,Region,Rank) 1-4: ";
-    for(int i = 0; i < 4; i++) {
-      cout << hex << setfill('0') << "(" << setw(1) << rctInfo[iBC].ieCard[i] << "," << setw(1) << rctInfo[iBC].ieRegn[i] << "," << setw(2) << rctInfo[iBC].ieRank[i] << ") ";
-    }
-    for(int i = 0; i < 4; i++) {
-      cout << hex << setfill('0') << "(" << setw(1) << rctInfo[iBC].neCard[i] << "," << setw(1) << rctInfo[iBC].neRegn[i] << "," << setw(2) << rctInfo[iBC].neRank[i] << ") ";
-    }
-    cout << endl;
-    cout << "HFET[2][4]:                       ";
-    for(int i = 0; i < 2; i++) {
-      for(int j = 0; j < 4; j++) {
-	cout << hex << setfill('0') << setw(3) << rctInfo[iBC].hfEt[i][j] << " ";
-      }
-    }
-    cout << endl;
-    cout << "RgnET[7][2]:                      ";
-    for(int i = 0; i < 7; i++) {
-      for(int j = 0; j < 2; j++) {
-	cout << hex << setfill('0') << setw(4) << rctInfo[iBC].rgnEt[i][j] << " ";
-      }
-    }
-    cout << endl;
-    cout << "Q/MIP/Tau/OF/HF-Q Bits:           ";
-    cout << hex << setfill('0') << setw(4) << rctInfo[iBC].qBits << " ";
-    cout << hex << setfill('0') << setw(4) << rctInfo[iBC].mBits << " ";
-    cout << hex << setfill('0') << setw(4) << rctInfo[iBC].tBits << " ";
-    cout << hex << setfill('0') << setw(4) << rctInfo[iBC].oBits << " ";
-    cout << hex << setfill('0') << setw(4) << rctInfo[iBC].hfQBits << endl;
-  }
-  cout << "Done" << endl;
+bool RCTInfoFactory::printRCTInfo(const RCTInfo *rctInfo, unsigned int nInfo){
+
+  //Formatted by RCTInfoDumper and written to cout in one go
+  RCTInfoDumper dumper;
+  dumper.sample();
+  for(unsigned int iBC = 0; iBC < nInfo; iBC++)
+    dumper.record(0, iBC, rctInfo[iBC].crateID, &rctInfo[iBC]);
+  dumper.endGroup();
+  dumper.flush();
   return true;
 }
 
@@ -468,17 +585,17 @@ bool RCTInfoFactory::printRCTInfoToFile(const std::vector<RCTInfo> &rctInfo, std
 
 bool RCTInfoFactory::verifyHammingCode(const unsigned char *data) {return true;};
 
-bool RCTInfoFactory::verifyBXBytes(const unsigned int &evenFiber, const unsigned int &oddFiber) {
+bool RCTInfoFactory::verifyBXBytes(const unsigned int &evenFiber, const unsigned int &oddFiber, unsigned int iBX) {
 
   bool status = true;
 
   if(((evenFiber&0xFF) != 0x7C) && ((evenFiber&0xFF) != 0x3C)){
-    std::cerr<<"Error BX Signal on Even Fiber is not 0x7C or 0x3C it is:"<< (evenFiber&0xFF) << std::endl;
+    errors->add(RCTFrameErrors::BadBXByte, evenLink, firstBX + iBX, evenFiber);
     status = false;
   }
 
   if(((oddFiber&0xFF) != 0x7C) && ((oddFiber&0xFF) != 0x3C)){
-    std::cerr<<"Error BX Signal on Odd Fiber is not 0x7C or 0x3C it is: "<< oddFiber <<" "<< (oddFiber&0xFF) << std::endl;
+    errors->add(RCTFrameErrors::BadBXByte, oddLink, firstBX + iBX, oddFiber);
     status = false;
   }
 
@@ -502,30 +619,24 @@ bool RCTInfoFactory::inAbortGap(const unsigned int &evenFiber, const unsigned in
 
 bool RCTInfoFactory::timeStampChar( char  timeStamp[80] )
 {
-  char *the_time = (char *) malloc(sizeof(char)*80);
   time_t rawtime;  struct tm * timeinfo;  
   time ( &rawtime ); timeinfo = localtime ( &rawtime );
-  strftime (the_time,80,"%b%d_%Hhr%Mmn%Ss",timeinfo);
-  strcpy(timeStamp, the_time);
+  strftime (timeStamp,80,"%b%d_%Hhr%Mmn%Ss",timeinfo);
   return true;
 }
 
 bool RCTInfoFactory::timeStampCharTime( char  timeStamp[80] )
 {
-  char *the_time = (char *) malloc(sizeof(char)*80);
   time_t rawtime;  struct tm * timeinfo;  
   time ( &rawtime ); timeinfo = localtime ( &rawtime );
-  strftime (the_time,80,"%H%M%S",timeinfo);
-  strcpy(timeStamp, the_time);
+  strftime (timeStamp,80,"%H%M%S",timeinfo);
   return true;
 }
 
 bool RCTInfoFactory::timeStampCharDate( char  timeStamp[80] )
 {
-  char *the_time = (char *) malloc(sizeof(char)*80);
   time_t rawtime;  struct tm * timeinfo;  
   time ( &rawtime ); timeinfo = localtime ( &rawtime );
-  strftime (the_time,80,"%d%m",timeinfo);
-  strcpy(timeStamp, the_time);
+  strftime (timeStamp,80,"%d%m",timeinfo);
   return true;
 }
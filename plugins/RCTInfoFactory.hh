@@ -2,6 +2,8 @@
 #define RCTInfoFactory_hh
 
 #include "RCTInfo.hh"
+#include "RCTInfoPacked.hh"
+#include "../src/RCTFrameErrors.hh"
 #include <iostream>
 #include <fstream>
 #include <vector>
@@ -14,19 +16,84 @@ public:
 
   enum EGError {NONE=0, RANK_SATURATED, RANK, ORDER, MISSING};
 
-  RCTInfoFactory() : verbose(false) {;}
+  // Per BX result of the span produce
+  // FRAME_BAD_CHECK_BYTE only comes with setCheckByteCheck(true)
+  enum FrameStatus {FRAME_OK=0, FRAME_ABORT_GAP, FRAME_BAD_BX_BYTE, FRAME_BAD_CHECK_BYTE};
+
+  // Read-only view of the frames of one fiber: frame iBX starts iBX * stride
+  // words in, so a view can run along a link buffer without copying it
+  struct FiberSpan {
+    FiberSpan(const unsigned int *words, unsigned int nWords, unsigned int frameStride = 6) :
+      data(words), nBX(nWords >= 6 ? (nWords - 6) / frameStride + 1 : 0), stride(frameStride) {;}
+    const unsigned int *frame(unsigned int iBX) const {return data + iBX * stride;}
+    const unsigned int *data;
+    unsigned int nBX;
+    unsigned int stride;
+  };
+
+  RCTInfoFactory() : verbose(false), checkByteCheck(false), errors(&ownErrors),
+    evenLink(RCTFrameErrors::NFibers), oddLink(RCTFrameErrors::NFibers), firstBX(0) {;}
   ~RCTInfoFactory() {;}
 
-  bool decodeCapturedLinkID(unsigned int capturedValue, unsigned int & crateNumber, unsigned int & linkNumber, bool & even);
+  static bool decodeCapturedLinkID(unsigned int capturedValue, unsigned int & crateNumber, unsigned int & linkNumber, bool & even);
   bool setRCTInfoCrateID(std::vector<RCTInfo> &rctInfoVector, unsigned int crateID);
-  bool produce(const std::vector <unsigned int> evenFiberData, 
-	       const std::vector <unsigned int> oddFiberData,
+  bool produce(const std::vector <unsigned int> &evenFiberData, 
+	       const std::vector <unsigned int> &oddFiberData,
 	       std::vector <RCTInfo> &rctInfo);
 
-  bool produce(const std::vector < std::vector <unsigned int> > cableData,
+  // Same, reading nWords words of each fiber in place
+  bool produce(const unsigned int *evenFiberData, 
+	       const unsigned int *oddFiberData,
+	       unsigned int nWords,
 	       std::vector <RCTInfo> &rctInfo);
 
+  // Decode up to capacity BXs in to rctInfo[] with a FrameStatus in status[];
+  // returns the number of BXs written. Abort gap BXs are left as RCTInfo().
+  unsigned int produce(const FiberSpan &evenFiber,
+		       const FiberSpan &oddFiber,
+		       RCTInfo *rctInfo,
+		       unsigned char *status,
+		       unsigned int capacity);
+
+  unsigned int produce(const FiberSpan &evenFiber,
+		       const FiberSpan &oddFiber,
+		       RCTInfoPacked *rctInfo,
+		       unsigned char *status,
+		       unsigned int capacity);
+
+  // oRSC capture RAM words of the 6 cables, 2 per BX; false unless they all have the same even size
+  bool produce(const std::vector < std::vector <unsigned int> > &cableData,
+	       std::vector <RCTInfo> &rctInfo);
+
+  // One BX of one crate; no state is touched, so tasks may decode in parallel
+  bool decodeFrame(const unsigned int *evenFiber, 
+		   const unsigned int *oddFiber,
+		   unsigned int iBX,
+		   RCTInfo &rctInfo) {
+    return decodeFrameStatus(evenFiber, oddFiber, iBX, rctInfo) != FRAME_BAD_BX_BYTE;
+  }
+  FrameStatus checkFrame(const unsigned int *evenFiber, 
+			 const unsigned int *oddFiber,
+			 unsigned int iBX);
+  FrameStatus verifyCheckBytes(const unsigned int *evenFiber, 
+			       const unsigned int *oddFiber,
+			       unsigned int iBX);
+  void checkBC0(const unsigned int *evenFiber, 
+		const unsigned int *oddFiber,
+		unsigned int iBX);
+  FrameStatus decodeFrameStatus(const unsigned int *evenFiber, 
+				const unsigned int *oddFiber,
+				unsigned int iBX,
+				RCTInfo &rctInfo);
+
+  // The frames decodeFrame reads back as rctInfo; bxByte is 0x3C or 0x7C
+  static void encodeFrame(const RCTInfo &rctInfo,
+			  unsigned int *evenFiber,
+			  unsigned int *oddFiber,
+			  unsigned int bxByte = 0x3C);
+
   bool printRCTInfo(const std::vector<RCTInfo> &rctInfo);
+  bool printRCTInfo(const RCTInfo *rctInfo, unsigned int nInfo);
 
   bool printRCTInfoToFile(const std::vector<RCTInfo> &rctInfo, std::ofstream &fileName);
 
@@ -34,6 +101,20 @@ public:
   unsigned int GetRegTenBits(RCTInfo rctInfo, unsigned int j, unsigned int k);
   unsigned int GetElectronTenBits(unsigned int Card, unsigned int Region, unsigned int Rank);
 
+  // Verify the FrameCheckByte of every frame decoded; only for frames DAQSpyPacker
+  // packed with check bytes, captured frames carry none
+  void setCheckByteCheck(bool check) {checkByteCheck = check;}
+
+  // Frame errors are counted, never printed, in to the factory's own RCTFrameErrors
+  // or in to stats; BX iBX of the fibers decoded next is counted as BX firstBX + iBX
+  void setErrorStats(RCTFrameErrors *stats) {errors = stats != 0 ? stats : &ownErrors;}
+  void setLinks(unsigned int even, unsigned int odd, unsigned int firstBXOfFibers = 0) {
+    evenLink = even;
+    oddLink = odd;
+    firstBX = firstBXOfFibers;
+  }
+  const RCTFrameErrors &errorStats() const {return *errors;}
+
   void setVerbose() {verbose = true;}
   void setQuiet() {verbose = false;}
 
@@ -42,6 +123,7 @@ public:
   bool timeStampCharDate( char  timeStamp[80] );
   bool GetUserName(char * username);
   bool verbose;
+  bool checkByteCheck;
 
 private:
 
@@ -54,10 +136,16 @@ private:
   // Helper functions
   bool verifyHammingCode(const unsigned char *data);
 
-  bool verifyBXBytes(const unsigned int &evenFiber, const unsigned int &oddFiber);
+  bool verifyBXBytes(const unsigned int &evenFiber, const unsigned int &oddFiber, unsigned int iBX);
 
   bool inAbortGap(const unsigned int &evenFiber, const unsigned int &oddFiber);
 
+  RCTFrameErrors ownErrors;
+  RCTFrameErrors *errors;
+  unsigned int evenLink;
+  unsigned int oddLink;
+  unsigned int firstBX;
+
 };
 
 #endif
@@ -0,0 +1,45 @@
+#include "RCTInfo.hh"
+#include "RCTInfoFactory.hh"
+#include "RCTInfoPacked.hh"
+
+RCTInfoPacked::RCTInfoPacked(const RCTInfo &rctInfo)
+{
+  RCTInfoFactory::encodeFrame(rctInfo, even, odd);
+}
+
+void RCTInfoPacked::unpack(RCTInfo &rctInfo, unsigned int crateID) const
+{
+  rctInfo.crateID = crateID;
+  rctInfo.linkIDEven = 0;
+  rctInfo.linkIDOdd = 0;
+  rctInfo.c1BC0 = c1BC0();
+  rctInfo.c2BC0 = c2BC0();
+  rctInfo.c3BC0 = c3BC0();
+  rctInfo.c4BC0 = c4BC0();
+  rctInfo.c5BC0 = c5BC0();
+  rctInfo.c6BC0 = c6BC0();
+  for(unsigned int j = 0; j < 4; j++) {
+    rctInfo.ieRank[j] = ieRank(j);
+    rctInfo.ieRegn[j] = ieRegn(j);
+    rctInfo.ieCard[j] = ieCard(j);
+    rctInfo.ieTenBit[j] = ieTenBit(j);
+    rctInfo.neRank[j] = neRank(j);
+    rctInfo.neRegn[j] = neRegn(j);
+    rctInfo.neCard[j] = neCard(j);
+    rctInfo.neTenBit[j] = neTenBit(j);
+  }
+  rctInfo.mBits = mBits();
+  rctInfo.qBits = 0;
+  rctInfo.oBits = oBits();
+  rctInfo.tBits = tBits();
+  for(unsigned int i = 0; i < 2; i++)
+    for(unsigned int j = 0; j < 4; j++)
+      rctInfo.hfEt[i][j] = hfEt(i, j);
+  for(unsigned int j = 0; j < 7; j++) {
+    for(unsigned int k = 0; k < 2; k++) {
+      rctInfo.rgnEt[j][k] = rgnEt(j, k);
+      rctInfo.rgnEtTenBit[j][k] = rgnEtTenBit(j, k);
+    }
+  }
+  rctInfo.hfQBits = hfQBits();
+}
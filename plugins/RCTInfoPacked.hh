@@ -0,0 +1,85 @@
+#ifndef RCTInfoPacked_hh
+#define RCTInfoPacked_hh
+
+#include <stdint.h>
+#include <string.h>
+
+class RCTInfo;
+
+/*
+ * One crate and BX as the 12 fiber words it arrived in, 48 bytes against
+ * the 328 of RCTInfo. Fields are cut out of the words when asked for.
+ *
+ * In the fiber format the region ETs (even fiber) and the EM candidates
+ * (odd fiber) are runs of 10 bit fields, so every accessor is a single
+ * bit field read at a fixed offset in the 192 bits of a fiber.
+ * Bit field description can be found in the spreadsheet:
+ * https://twiki.cern.ch/twiki/pub/CMS/ORSCOperations/oRSCFiberDataSpecificationV5.xlsx
+ */
+
+class RCTInfoPacked {
+
+public:
+
+  RCTInfoPacked() : even(), odd() {;}
+  RCTInfoPacked(const unsigned int *evenFiber, const unsigned int *oddFiber) {set(evenFiber, oddFiber);}
+
+  // Same fiber words RCTInfoFactory::encodeFrame makes from rctInfo
+  explicit RCTInfoPacked(const RCTInfo &rctInfo);
+
+  void set(const unsigned int *evenFiber, const unsigned int *oddFiber) {
+    memcpy(even, evenFiber, sizeof(even));
+    memcpy(odd, oddFiber, sizeof(odd));
+  }
+
+  // Full RCTInfo, derived fields included, for code that still wants one
+  void unpack(RCTInfo &rctInfo, unsigned int crateID) const;
+
+  const unsigned int *evenFiber() const {return even;}
+  const unsigned int *oddFiber() const {return odd;}
+  unsigned int *evenFiber() {return even;}
+  unsigned int *oddFiber() {return odd;}
+
+  // Even fiber: 4x4 regions, tau and overflow bits, BC0 marks of cables 4-6
+  constexpr unsigned int rgnEt(unsigned int card, unsigned int region) const {return bits(even, 8 + 10 * (card * 2 + region), 10);}
+  constexpr unsigned int tBits() const {return bits(even, 148, 14);}
+  constexpr unsigned int oBits() const {return bits(even, 162, 14);}
+  constexpr unsigned int c4BC0() const {return bits(even, 178, 2);}
+  constexpr unsigned int c5BC0() const {return bits(even, 180, 2);}
+  constexpr unsigned int c6BC0() const {return bits(even, 182, 2);}
+
+  // Odd fiber: HF, EM candidates as rank (6), region (1), card (3), MIP bits, BC0 marks of cables 1-4
+  constexpr unsigned int hfEt(unsigned int i, unsigned int j) const {return bits(odd, 8 + 8 * ((j / 2) * 4 + i * 2 + j % 2), 8);}
+  constexpr unsigned int hfQBits() const {return bits(odd, 72, 8);}
+  constexpr unsigned int ieTenBit(unsigned int j) const {return bits(odd, 80 + 10 * j, 10);}
+  constexpr unsigned int neTenBit(unsigned int j) const {return bits(odd, 120 + 10 * j, 10);}
+  constexpr unsigned int ieRank(unsigned int j) const {return ieTenBit(j) & 0x3F;}
+  constexpr unsigned int ieRegn(unsigned int j) const {return (ieTenBit(j) >> 6) & 0x1;}
+  constexpr unsigned int ieCard(unsigned int j) const {return ieTenBit(j) >> 7;}
+  constexpr unsigned int neRank(unsigned int j) const {return neTenBit(j) & 0x3F;}
+  constexpr unsigned int neRegn(unsigned int j) const {return (neTenBit(j) >> 6) & 0x1;}
+  constexpr unsigned int neCard(unsigned int j) const {return neTenBit(j) >> 7;}
+  constexpr unsigned int mBits() const {return bits(odd, 160, 14);}
+  constexpr unsigned int c1BC0() const {return bits(odd, 176, 2);}
+  constexpr unsigned int c2BC0() const {return bits(odd, 178, 2);}
+  constexpr unsigned int c3BC0() const {return bits(odd, 180, 2);}
+
+  // Region ET with the tau and overflow bits in bits 11 and 10, as RCTInfo::rgnEtTenBit
+  constexpr unsigned int rgnEtTenBit(unsigned int card, unsigned int region) const {
+    return (((tBits() >> (card * 2 + region)) & 0x1) << 11) | (((oBits() >> (card * 2 + region)) & 0x1) << 10) | rgnEt(card, region);
+  }
+
+private:
+
+  // n bits from bit position pos of a fiber, possibly running on in to the next word
+  static constexpr unsigned int bits(const unsigned int *words, unsigned int pos, unsigned int n) {
+    return ((words[pos / 32] >> (pos % 32)) |
+	    ((pos % 32 + n > 32) ? (words[pos / 32 + 1] << (32 - pos % 32)) : 0)) & ((1u << n) - 1);
+  }
+
+  unsigned int even[6];
+  unsigned int odd[6];
+
+};
+
+#endif
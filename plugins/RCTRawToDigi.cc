@@ -0,0 +1,240 @@
+// -*- C++ -*-
+//
+// Package:    TestProducer/RCTRawToDigi
+// Class:      RCTRawToDigi
+//
+/**\class RCTRawToDigi RCTRawToDigi.cc TestProducer/RCTRawToDigi/plugins/RCTRawToDigi.cc
+
+   Description: Unpacks the CTP7 DAQ block from the central DAQ stream
+
+   Implementation:
+   The CTP7 sends the AMC13 the same block RCTToDigi reads from the DAQ
+   spy buffer: 6 event header words, then per link 2 channel header words
+   and 6 words per BX. This module finds that block in the FED payload and
+   decodes it with DAQSpyBlock and DAQSpyDecoder, like RCTToDigi does.
+   It is a stream module, so events are unpacked on as many threads as
+   the job runs streams.
+*/
+//
+
+
+// system include files
+#include <memory>
+#include <iostream>
+#include <string>
+#include <atomic>
+
+// user include files
+#include "FWCore/Framework/interface/Frameworkfwd.h"
+#include "FWCore/Framework/interface/stream/EDProducer.h"
+
+#include "FWCore/Framework/interface/Event.h"
+#include "FWCore/Framework/interface/MakerMacros.h"
+
+#include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "FWCore/Utilities/interface/InputTag.h"
+
+#include "DataFormats/FEDRawData/interface/FEDRawData.h"
+#include "DataFormats/FEDRawData/interface/FEDRawDataCollection.h"
+
+#include "DataFormats/L1CaloTrigger/interface/L1CaloEmCand.h"
+#include "DataFormats/L1CaloTrigger/interface/L1CaloRegion.h"
+#include "DataFormats/L1CaloTrigger/interface/L1CaloCollections.h"
+
+#include "../src/RCTFrameErrors.hh"
+
+#include "DAQSpyBlock.hh"
+#include "DAQSpyDecoder.hh"
+
+using namespace std;
+
+//
+// class declaration
+//
+
+class RCTRawToDigi : public edm::stream::EDProducer<> {
+public:
+  explicit RCTRawToDigi(const edm::ParameterSet&);
+  ~RCTRawToDigi();
+
+  static void fillDescriptions(edm::ConfigurationDescriptions& descriptions);
+
+private:
+  virtual void produce(edm::Event&, const edm::EventSetup&) override;
+  bool findAMCPayload(const FEDRawData &fedData, const uint32_t *&words, uint32_t &nWords) const;
+  bool reportError();
+
+  // ----------member data ---------------------------
+
+  edm::EDGetTokenT<FEDRawDataCollection> fedToken;
+  int fedID;
+  int amcSlot;
+  bool amc13Payload;
+
+  // Reused between the events of this stream
+  DAQSpyBlock daqBlock;
+  DAQSpyDecoder decoder;
+
+  // Error printouts are limited per job, not per stream
+  static std::atomic<uint32_t> nErrorPrints;
+  uint32_t maxErrorPrints;
+
+};
+
+//
+// constants, enums and typedefs
+//
+
+// AMC13 64 bit words: CDF header, AMC13 header, one header per AMC, ..., AMC13 trailer, CDF trailer
+const uint32_t AMC13HeaderWords = 2;
+const uint32_t AMC13TrailerWords = 2;
+// The CTP7 block is the AMC payload, its event header is the AMC header
+// (event size and BcN in word 0, L1A number in word 1); one trailer word follows
+const uint32_t AMCTrailerWords = 1;
+
+//
+// static data member definitions
+//
+
+std::atomic<uint32_t> RCTRawToDigi::nErrorPrints(0);
+
+//
+// constructors and destructor
+//
+RCTRawToDigi::RCTRawToDigi(const edm::ParameterSet& iConfig)
+{
+  fedToken = consumes<FEDRawDataCollection>(iConfig.getUntrackedParameter<edm::InputTag>("inputLabel",edm::InputTag("rawDataCollector")));
+  fedID = iConfig.getUntrackedParameter<int>("fedID",1350);
+  //AMC13 slot of the CTP7, 0 takes the first AMC in the payload
+  amcSlot = iConfig.getUntrackedParameter<int>("amcSlot",0);
+  //False if the FED payload is the bare DAQ block, as written by some test setups
+  amc13Payload = iConfig.getUntrackedParameter<bool>("amc13Payload",true);
+  maxErrorPrints = iConfig.getUntrackedParameter<unsigned int>("maxErrorPrints",100);
+  //Events already run on separate streams, so crates and BXs are decoded serially by default
+  decoder.setParallel(iConfig.getUntrackedParameter<bool>("parallelDecode",false));
+  //Only blocks RCTDigiToRaw packed with packerCheckBytes carry check bytes
+  decoder.setCheckByteCheck(iConfig.getUntrackedParameter<bool>("verifyCheckBytes",false));
+
+  produces<L1CaloEmCollection>();
+  produces<L1CaloRegionCollection>();
+  produces<RCTFrameErrors>();
+}
+
+
+RCTRawToDigi::~RCTRawToDigi()
+{
+}
+
+
+//
+// member functions
+//
+
+bool RCTRawToDigi::reportError(){
+  return nErrorPrints++ < maxErrorPrints;
+}
+
+/*
+ * Locate the CTP7 block in an AMC13 payload. Blocks are at most
+ * NIntsBRAMDAQ words, so the AMC is never split over several AMC13 blocks.
+ */
+
+bool RCTRawToDigi::findAMCPayload(const FEDRawData &fedData, const uint32_t *&words, uint32_t &nWords) const {
+
+  const uint64_t *data = reinterpret_cast<const uint64_t *>(fedData.data());
+  uint32_t size = fedData.size() / sizeof(uint64_t);
+
+  if(!amc13Payload) {
+    words = reinterpret_cast<const uint32_t *>(fedData.data());
+    nWords = fedData.size() / sizeof(uint32_t);
+    return nWords != 0;
+  }
+
+  if(size < AMC13HeaderWords + AMC13TrailerWords)
+    return false;
+  uint32_t nAMC = (data[1] >> 52) & 0xF;
+  if(size < AMC13HeaderWords + nAMC + AMC13TrailerWords)
+    return false;
+
+  //AMC payloads follow the AMC headers in the same order
+  uint32_t offset = AMC13HeaderWords + nAMC;
+  for(uint32_t i = 0; i < nAMC; i++) {
+    uint64_t amcHeader = data[AMC13HeaderWords + i];
+    uint32_t amcSize = (amcHeader >> 32) & 0xFFFFFF;
+    uint32_t slot = (amcHeader >> 16) & 0xF;
+    if(offset + amcSize > size - AMC13TrailerWords)
+      return false;
+    if(amcSlot == 0 || (uint32_t) amcSlot == slot) {
+      if(amcSize <= AMCTrailerWords)
+	return false;
+      words = reinterpret_cast<const uint32_t *>(data + offset);
+      nWords = 2 * (amcSize - AMCTrailerWords);
+      return true;
+    }
+    offset += amcSize;
+  }
+  return false;
+}
+
+// ------------ method called to produce the data  ------------
+void
+RCTRawToDigi::produce(edm::Event& iEvent, const edm::EventSetup& iSetup)
+{
+  using namespace edm;
+
+  std::auto_ptr<L1CaloEmCollection> rctEMCands(new L1CaloEmCollection);
+  std::auto_ptr<L1CaloRegionCollection> rctRegions(new L1CaloRegionCollection);
+  std::auto_ptr<RCTFrameErrors> frameErrors(new RCTFrameErrors);
+
+  Handle<FEDRawDataCollection> fedData;
+  iEvent.getByToken(fedToken, fedData);
+
+  const uint32_t *words = 0;
+  uint32_t nWords = 0;
+  if(!fedData.isValid()) {
+    if(reportError())
+      cerr << "RCTRawToDigi::produce() No FEDRawDataCollection" << endl;
+  }
+  else if(!findAMCPayload(fedData->FEDData(fedID), words, nWords)) {
+    if(reportError())
+      cerr << "RCTRawToDigi::produce() No CTP7 block in FED " << fedID << " of size " << fedData->FEDData(fedID).size() << endl;
+  }
+  else {
+    //The AMC payload may be padded to 64 bits, so only header word 0 is cross-checked
+    DAQSpyBlock::Status status = daqBlock.parse(words, nWords);
+    if(daqBlock.sizeMismatch() && reportError())
+      cerr << "RCTRawToDigi::produce() L1ID " << daqBlock.l1ID() << " header event size " << daqBlock.headerWords()
+	   << " words, " << daqBlock.nBX() << " BXs take " << daqBlock.expectedWords() << endl;
+    if(status == DAQSpyBlock::Ok || status == DAQSpyBlock::CorruptedLinks) {
+      status = decoder.decode(daqBlock);
+      decoder.fillCollections(*rctEMCands, *rctRegions);
+      *frameErrors = decoder.frameErrors();
+    }
+    if(status != DAQSpyBlock::Ok && reportError()) {
+      cerr << "RCTRawToDigi::produce() L1ID " << daqBlock.l1ID() << " DAQ block " << DAQSpyBlock::statusName(status)
+	   << ", " << decoder.cratesFound() << " crates, corrupted links " << std::hex << decoder.corruptedLinks() << std::dec << endl;
+    }
+  }
+
+  iEvent.put(rctEMCands);
+  iEvent.put(rctRegions);
+  iEvent.put(frameErrors);
+}
+
+// ------------ method fills 'descriptions' with the allowed parameters for the module  ------------
+void
+RCTRawToDigi::fillDescriptions(edm::ConfigurationDescriptions& descriptions) {
+  edm::ParameterSetDescription desc;
+  desc.setComment("Unpacks the CTP7 DAQ block from the central DAQ stream");
+  desc.addUntracked<edm::InputTag>("inputLabel", edm::InputTag("rawDataCollector"))->setComment("FEDRawDataCollection to unpack");
+  desc.addUntracked<int>("fedID", 1350)->setComment("FED id of the AMC13 reading out the CTP7");
+  desc.addUntracked<int>("amcSlot", 0)->setComment("AMC13 slot of the CTP7, 0 for the first AMC");
+  desc.addUntracked<bool>("amc13Payload", true)->setComment("FED data is an AMC13 payload, false if it is the bare DAQ block");
+  desc.addUntracked<unsigned int>("maxErrorPrints", 100)->setComment("Number of bad events reported per job");
+  desc.addUntracked<bool>("parallelDecode", false)->setComment("Also decode the crates and BXs of each event as parallel tasks");
+  desc.addUntracked<bool>("verifyCheckBytes", false)->setComment("Verify the frame check bytes RCTDigiToRaw writes with packerCheckBytes; never for CTP7 data, which carries none");
+  descriptions.addDefault(desc);
+}
+
+//define this as a plug-in
+DEFINE_FWK_MODULE(RCTRawToDigi);
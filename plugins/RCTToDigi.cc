@@ -30,6 +30,7 @@
 #include "FWCore/Framework/interface/EDProducer.h"
 
 #include "FWCore/Framework/interface/Event.h"
+#include "FWCore/Framework/interface/Run.h"
 #include "FWCore/Framework/interface/MakerMacros.h"
 
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
@@ -38,7 +39,8 @@
 
 #include "CTP7Client.hh"
 #include "RCTInfoFactory.hh"
-//#include "../src/L1CaloBXCollections.hh"
+#include "../src/L1CaloBXCollections.hh"
+#include "../src/RCTFrameErrors.hh"
 
 // RCT data formats
 #include "DataFormats/L1CaloTrigger/interface/L1CaloEmCand.h"
@@ -54,19 +56,21 @@
 
 #include "CTP7Tests/LinkMonitor/interface/LinkMonitor.h"
 #include "CTP7Tests/TimeMonitor/interface/TimeMonitor.h"
-#include "RunNumberFactory.hh"
+#include "CaptureMetadata.hh"
+#include "PatternFileLoader.hh"
+#include "CaptureFile.hh"
+#include "DumpWriter.hh"
+#include "CaptureWaiter.hh"
+#include "DAQSpyBlock.hh"
+#include "DAQSpyDecoder.hh"
+#include "BXWindow.hh"
+#include "RCTInfoDumper.hh"
 
 //utility
 #include "Math/LorentzVector.h"
 #include "DataFormats/L1Trigger/interface/L1Candidate.h"
 using namespace std;
 
-#define EVENT_HEADER_WORDS 6
-#define CHANNEL_HEADER_WORDS 2
-#define CHANNEL_DATA_WORDS_PER_BX 6
-#define NIntsBRAMDAQ 1024*2
-#define NLinks 36
-
 // Scan in file
 
 #include <fstream>
@@ -87,11 +91,10 @@ private:
   virtual void beginJob() override;
   virtual void produce(edm::Event&, const edm::EventSetup&) override;
   int getLinkNumber(bool even, int crate);
-  bool scanInDAQData(uint32_t tempBuffer[NIntsBRAMDAQ]);
-  void printDAQToFile();
   bool waitForCaptureSuccess();
-  bool decodeCapturedLinkID(uint32_t capturedValue, uint32_t &crateNumber, uint32_t &linkNumber, bool &even);
-  bool getBXNumbers(const uint32_t L1aBCID, const uint32_t BXsInCapture, unsigned int BCs[5], uint32_t firstBX, uint32_t lastBX);
+  bool spyCapture(uint32_t *destination, uint32_t &eventSize);
+  DAQSpyBlock::Status unpackDAQ(L1CaloEmCollection &emCands, L1CaloRegionCollection &regions);
+  void putBXVectors(edm::Event &iEvent, const L1CaloEmCollection &emCands, const L1CaloRegionCollection &regions);
   virtual void endJob() override;      
   virtual void beginRun(edm::Run const&, edm::EventSetup const&) override;
   virtual void endRun(edm::Run const&, edm::EventSetup const&) override;
@@ -108,11 +111,37 @@ private:
   
   uint32_t buffer[NIntsBRAMDAQ];
 
+  CaptureMetadata metadata;
+
   int NEventsPerCapture;
   bool test;
   bool createDAQFile;
 
-  char fileName[40];
+  PatternFileLoader patternFile;
+
+  // Binary capture files: written in normal running, read back in test mode
+  std::string captureFile;
+  CaptureFile::Reader captureReader;
+  bool compressCaptureFile;
+
+  // DAQ text dumps and capture file records are written off the event loop
+  DumpWriter *dumpWriter;
+  CaptureWaiter captureWaiter;
+  bool asyncDump;
+
+  // Views over buffer and decoded crates, reused between events
+  DAQSpyBlock daqBlock;
+  DAQSpyDecoder decoder;
+
+  // Text dumps of the decoded crates of one capture in every infoDumpPrescale
+  RCTInfoDumper infoDumper;
+
+  // BCIDs of the BXs read out around the L1A of the current event
+  BXWindow bxWindow;
+  bool bxVectorOutput;
+
+  // DAQ_SPY_CAPTURE_EVENT_SIZE_REG of the last capture, 0 when replaying files
+  uint32_t daqEventSize;
 
 };
 
@@ -122,9 +151,6 @@ private:
 
 const uint32_t NIntsPerFrame = 6;
 
-//Fill a vector to fill LinkMonitorCollection later
-typedef std::vector<uint32_t> LinkMonitorTmp;
-
 struct crate_data{
   unsigned int crateID;
   unsigned int BXID;
@@ -140,17 +166,6 @@ struct crate_data{
   std::vector <unsigned int> uintOdd;
 };
 
-struct link_data{
-  unsigned int ctp7LinkNumber;
-  //full 32-bit linkID
-  unsigned int capturedLinkID;
-  //decoded linkID from the oRSC
-  unsigned int capturedLinkNumber;
-  bool even;
-  unsigned int crateID;
-  std::vector <unsigned int> uint;
-};
-
 
 //
 // static data member definitions
@@ -169,23 +184,57 @@ RCTToDigi::RCTToDigi(const edm::ParameterSet& iConfig)
   test = iConfig.getUntrackedParameter<bool>("test",false);
   createDAQFile = iConfig.getUntrackedParameter<bool>("createDAQFile",false);
   testFile = iConfig.getUntrackedParameter<std::string>("testFile","testFile.txt");
+  captureFile = iConfig.getUntrackedParameter<std::string>("captureFile","");
+  compressCaptureFile = iConfig.getUntrackedParameter<bool>("compressCaptureFile",true);
   // Create CTP7Client to communicate with specified host/port 
+  ctp7Client = 0;
+  daqEventSize = 0;
   if(!test)
     ctp7Client = new CTP7Client(ctp7Host.c_str(), ctp7Port.c_str());
+  //Crates and BXs are decoded as separate tasks on the TBB pool
+  decoder.setParallel(iConfig.getUntrackedParameter<bool>("parallelDecode",true));
+  //Decoded crates are dumped as text: human, csv or jsonl, level 0 off, 1 crates, 2 crates and fiber words
+  infoDumper.setup(iConfig.getUntrackedParameter<std::string>("infoDumpFormat","human"),
+		   iConfig.getUntrackedParameter<int>("infoDumpLevel",0),
+		   iConfig.getUntrackedParameter<unsigned int>("infoDumpPrescale",1),
+		   iConfig.getUntrackedParameter<std::string>("infoDumpFile",""));
+  //Bulk reads arrive FrameCodec encoded, the CTP7 server has to support getEncodedValues
+  if(ctp7Client != 0)
+    ctp7Client->setEncodedTransfer(iConfig.getUntrackedParameter<bool>("encodedTransfer",false));
+
+  //Capture polls back off from 5 us up to captureMaxBackoffUs until captureTimeoutMs
+  captureWaiter.configure(5, iConfig.getUntrackedParameter<unsigned int>("captureMaxBackoffUs",1000),
+			  iConfig.getUntrackedParameter<unsigned int>("captureTimeoutMs",1000));
+
+  dumpWriter = 0;
+  asyncDump = iConfig.getUntrackedParameter<bool>("asyncDump",true);
+  if(createDAQFile || (!test && !captureFile.empty())) {
+    dumpWriter = new DumpWriter(1, NIntsBRAMDAQ,
+				iConfig.getUntrackedParameter<int>("dumpQueueDepth",4),
+				iConfig.getUntrackedParameter<bool>("dumpDropWhenFull",false));
+    if(createDAQFile)
+      dumpWriter->setTextFile(DumpWriter::DAQText, "outputFileDAQ.txt");
+  }
 
-  //set test file name here, shoudl be added as an untrackedParamater
-  sprintf(fileName,testFile.c_str());
+  //Also put the readout window as BXVector collections, BX 0 being the L1A
+  bxVectorOutput = iConfig.getUntrackedParameter<bool>("bxVectorOutput",false);
 
   //register your products
   produces<L1CaloEmCollection>();
   produces<L1CaloRegionCollection>();
+  if(bxVectorOutput) {
+    produces<L1CaloEmCandBxCollection>();
+    produces<L1CaloRegionBxCollection>();
+  }
   produces<LinkMonitorCollection>();
   produces<TimeMonitorCollection>();
+  produces<RCTFrameErrors>();
 }
 
 
 RCTToDigi::~RCTToDigi()
 {
+  delete dumpWriter;
   // Close CTP7Client connection
   if(ctp7Client != 0) delete ctp7Client;
 }
@@ -198,7 +247,7 @@ RCTToDigi::~RCTToDigi()
 
 // ------------ method called to produce the data  ------------
 // NOTICE: A Number of data checks are performed, if data appears
-//         corrupted then this will produce nothing.
+//         corrupted the bad links are left out of the collections.
 //
 
 void
@@ -206,9 +255,6 @@ RCTToDigi::produce(edm::Event& iEvent, const edm::EventSetup& iSetup)
 {
   using namespace edm;
 
-  RCTInfoFactory rctInfoFactory;
-  RunNumberFactory runNumberFactory;
-
   std::auto_ptr<TimeMonitorCollection> rctTime(new TimeMonitorCollection);
 
   std::auto_ptr<L1CaloEmCollection> rctEMCands(new L1CaloEmCollection);
@@ -217,9 +263,6 @@ RCTToDigi::produce(edm::Event& iEvent, const edm::EventSetup& iSetup)
   //LinkMonitorCollection Final Output Collection
   std::auto_ptr<LinkMonitorCollection> rctLinkMonitor(new LinkMonitorCollection);
 
-  //Grab the link vector by first filling a different class-less type
-  std::auto_ptr<LinkMonitorTmp> rctLinksTmp(new LinkMonitorTmp);
-
 
   static uint32_t index = 0;
   static uint32_t countCycles = 0;
@@ -234,248 +277,65 @@ RCTToDigi::produce(edm::Event& iEvent, const edm::EventSetup& iSetup)
       cout<<"to capture data from CTP7, think again!"<<endl;
       cout<<"Exiting..."<<endl; exit(0);
     }
-    ctp7Client->setValue( CTP7::daqSpyCaptureRegisters, 0,1);
-    
-    int nAttempts = 0;
-    while(1 != ctp7Client->getValue(CTP7::daqSpyCaptureRegisters, 1)){
-      usleep(5);
-      if(nAttempts>20){
-	cout<<"--------- Capture Failed, check if Run is going, Exiting. ----------"<<endl;
-	  exit(0);
-      }
+    //The capture is read straight in to buffer, and stamped with its own link status and time
+    if(!spyCapture(buffer, daqEventSize)){
+      cout<<"--------- Capture Failed, check if Run is going, Exiting. ----------"<<endl;
+      exit(0);
     }
-
-    if(!ctp7Client->getValues(CTP7::daqBuffer,0,2047,buffer)){
-      cerr << "RCTToDigi::produce() Error reading DAQ from CTP7" << endl;
-    }
-
-    //Fill the rctLinksTmp 
-    ctp7Client->dumpStatus(*rctLinksTmp);
+    if(!metadata.newCapture(ctp7Client))
+      cerr << "RCTToDigi::produce() Error reading link status from CTP7" << endl;
     
-    for (uint32_t i = 0; i < rctLinksTmp->size() ; i++){
-      rctLinkMonitor->push_back(LinkMonitor(rctLinksTmp->at(i)));
+    for (uint32_t i = 0; i < metadata.linkStatus.size() ; i++){
+      rctLinkMonitor->push_back(LinkMonitor(metadata.linkStatus[i]));
     }
-    //Fill Timing Plots
-    int32_t run = runNumberFactory.RunSummary();
-    //std::cout<<"Run: "<<run<<std::endl;
-  
-    //get date in int form "ddmm"-- if first day starts with zero, will be 3 numbers long
-    char date[80];
-    rctInfoFactory.timeStampCharDate(date);
-    uint16_t ddmm = atol(date);
- 
-    //get time in long int form "hhmmss"-- if first hour starts with zero(s) will be 5(4) numbers long.
-    char clock[80];
-     rctInfoFactory.timeStampCharTime(clock);
-    uint32_t hms = atol(clock);
-    //Fill the time collection
-    rctTime->push_back(TimeMonitor(ddmm,hms,run));
-    
-
-
-
+    //Fill Timing Plots, run number is resolved once per run in beginRun
+    rctTime->push_back(TimeMonitor(metadata.ddmm,metadata.hms,metadata.run));
   }
   else { // test mode
     cout <<"TESTING MODE"<<endl;
-    if(!scanInDAQData(buffer)){
+    daqEventSize = 0;
+    bool status;
+    if(captureReader.captures() != 0) {
+      //Replay the captures of a .ctp7cap file in turn
+      uint32_t capture = (countCycles - 1) % captureReader.captures();
+      status = captureReader.readBlock(capture, 0, buffer, NIntsBRAMDAQ) != 0;
+    }
+    else {
+      //The DAQ dump is parsed once and cached between events
+      status = patternFile.loadWords(testFile, buffer, NIntsBRAMDAQ);
+    }
+    if(!status){
       cerr << "RCTToDigi::produce() Error reading from file: " << testFile << endl;
     }
   }
   
-  if(createDAQFile)
-    printDAQToFile();
+  if(dumpWriter != 0) {
+    int slot = dumpWriter->acquire();
+    if(slot >= 0) {
+      memcpy(dumpWriter->data(slot), buffer, sizeof(buffer));
+      dumpWriter->submit(slot, CaptureFile::makeHeader(CaptureFile::DAQPayload, ctp7Host, metadata.gitHash,
+						       metadata.run, buffer[5] & 0x00000FFF));
+    }
+  }
 
 
   // Dump DAQ Buffer and decode into individual crate even and odd link data
   // channels to make rctInfo buffer, and from that make rctEMCands and rctRegions
-  uint32_t nBX = 0; 
-  uint32_t ctp7FWVersion;
-  uint32_t L1ID, L1aBCID;
-  uint32_t BCs[5] = {0}; //5 BCs is max readout
-     
-  L1ID          =  buffer[1];                      // extract the L1 ID number
-  L1aBCID       =  buffer[5] & 0x00000FFF;         // extract the BCID number of L1A
-  nBX           = (buffer[5] & 0x00FF0000) >> 16;  // extract number of BXs readout per L1A 
-  ctp7FWVersion =  buffer[4];
-  
-  cout << "L1ID = " << L1ID << " L1A BCID = " << L1aBCID << " BXs in capture = " << nBX << " CTP7 DAQ FW = " << ctp7FWVersion<<endl;
-  
-  //getBXNumbers handles special cases, for example:
-  //if L1A is 3563, nBX = 3 then BCs = 3562, 3563, 0
-  uint32_t firstBX = 0; uint32_t lastBX = 1; 
-  getBXNumbers(L1aBCID, nBX, BCs, firstBX, lastBX);
-  
-  //rctRegions->setBXRange(0, nBX);
-  //rctEMCands->setBXRange(0, nBX);
-  
-  std::vector<RCTInfo> allCrateRCTInfo[nBX];
-  
-  link_data allLinks[nBX][NLinks];
-  
-  uint32_t iDAQBuffer = 0;
-  
-  //Step 1: Grab all data from ctp7 buffer and put into link format
-  for(unsigned int iLink = 0; iLink < NLinks; iLink++ ){
-    
-    iDAQBuffer = EVENT_HEADER_WORDS + iLink * (CHANNEL_HEADER_WORDS + 
-					       nBX * CHANNEL_DATA_WORDS_PER_BX);
-    
-    //first decode linkID 
-    uint32_t linkID     = buffer[iDAQBuffer++];
-    uint32_t tmp        = buffer[iDAQBuffer++];
-    uint32_t CRCErrCnt  =  tmp & 0x0000FFFF;
-    //uint32_t linkStatus = (tmp & 0xFFFF0000) >> 16;
-    //cout<<"linkID "<<std::hex<<linkID<<" CRCErrCnt "<<CRCErrCnt<<endl;
-    if(CRCErrCnt!=0)
-      std::cout<<"WARNING CRC ErrorFound"<<std::endl;
-    
-    uint32_t capturedLinkID = 0;
-    uint32_t crateID = 0;
-    uint32_t capturedLinkNumber = 0;
-    bool even = false;
-    
-    //Using normal method for decoding oRSC Captured LinkID
-    //Input linkID, output: crateID, capturedLinkNumber, Even or Odd
-    decodeCapturedLinkID(linkID, crateID, capturedLinkNumber, even);
-    
-    // Loop over multiple BX                                                                        
-    for (uint32_t iBX=0; iBX<nBX; iBX++){
-      //std::cout<<"iBX "<<iBX<<endl;
-      allLinks[iBX][iLink].uint.reserve(6);
-      allLinks[iBX][iLink].ctp7LinkNumber     = iLink;
-      allLinks[iBX][iLink].capturedLinkID     = capturedLinkID;
-      allLinks[iBX][iLink].crateID            = crateID;
-      allLinks[iBX][iLink].capturedLinkNumber = capturedLinkNumber;
-      allLinks[iBX][iLink].even               = even;
-
-      //std::cout<<std::dec<<"iLink "<<iLink<<" crateID "<<crateID<<" even "<<even<<std::endl;   
-
-      for(unsigned int iWord = 0; iWord < 6 ; iWord++ ){
-	//printf("0x%8.8X ", buffer[iDAQBuffer+iWord+iBX*6]);    
-	allLinks[iBX][iLink].uint.push_back(buffer[iDAQBuffer+iWord+iBX*6]);
-	//allLinks[iLink][iBX].uint.push_back(buffer[iDAQBuffer+iWord]);
-      }
-      //cout<<endl;
-    }
-  }
+  DAQSpyBlock::Status status = unpackDAQ(*rctEMCands, *rctRegions);
 
-  //Step 2: Dynamically match links and create RCTInfo Objects 
-  uint32_t nCratesFound = 0;
-  for(unsigned int iCrate = 0; iCrate < 18 ; iCrate++){
-    
-    bool foundEven = false, foundOdd = false;
-    link_data even[nBX];
-    link_data odd[nBX];
-    
-    for(unsigned int iLink = 0; iLink < NLinks; iLink++){
-      
-      if( (allLinks[0][iLink].crateID==iCrate) && (allLinks[0][iLink].even == true) ){
-	
-	foundEven = true;
-	for (unsigned int iBX=0; iBX<nBX; iBX++)
-	  even[iBX] = allLinks[iBX][iLink];
-	
-      }
-      else if( (allLinks[0][iLink].crateID==iCrate) && (allLinks[0][iLink].even == false) ){
-	
-	foundOdd = true;
-	for (unsigned int iBX=0; iBX<nBX; iBX++)
-	  odd[iBX] = allLinks[iBX][iLink];
-	
-      } 
-      //if success then create RCTInfoVector and fill output object
-      if(foundEven && foundOdd){
-	nCratesFound++;
-	   
-	//fill rctInfoVector for all BX read out
-	for (unsigned int iBX=0; iBX<nBX; iBX++){
-	  RCTInfoFactory rctInfoFactory;
-	  std::vector <RCTInfo> rctInfoData;
-          if(!rctInfoFactory.produce(even[iBX].uint, odd[iBX].uint, rctInfoData)){
-            std::cout<<"Failed to produce data; corrupted data? Exiting."<<std::endl;
-            return;
-          }
-	  rctInfoFactory.setRCTInfoCrateID(rctInfoData, iCrate);
-	  allCrateRCTInfo[iBX].push_back(rctInfoData.at(0));
-	}
-	break;
-      }
-    }
-  }
-  
-  if(nCratesFound != 18)
-    cerr << "Warning -- only found "<< nCratesFound << " valid crates";
-  
-  //Step 3: Create Collections from RCTInfo Objects  
-  for (uint32_t iBX=0; iBX<nBX; iBX++){
-    
-    int bx = BCs[iBX];
-    for(unsigned int iCrate = 0; iCrate < nCratesFound; iCrate++ ){
-
-      RCTInfo rctInfo = allCrateRCTInfo[iBX].at(iCrate);
-      RCTInfoFactory rctInfoFactory;
-
-      rctInfoFactory.printRCTInfo(allCrateRCTInfo[iBX]);
-      //Use Crate ID to identify eta/phi of candidate
-      for(int j = 0; j < 4; j++) {
-
-	L1CaloEmCand em = L1CaloEmCand(rctInfo.neRank[j], 
-				       rctInfo.neRegn[j], 
-				       rctInfo.neCard[j], 
-				       rctInfo.crateID, 
-				       false);
-	em.setBx(iBX);
-	rctEMCands->push_back(em);
-	
-      }
-      
-      for(int j = 0; j < 4; j++) {
-	
-	L1CaloEmCand em = L1CaloEmCand(rctInfo.ieRank[j], 
-				       rctInfo.ieRegn[j], 
-				       rctInfo.ieCard[j], 
-				       rctInfo.crateID, 
-				       true);
-	
-	em.setBx(iBX);
-	rctEMCands->push_back( em);
-      }
-
-	 for(int j = 0; j < 7; j++) {
-
-	   for(int k = 0; k < 2; k++) {
-	     
-	     bool o = (((rctInfo.oBits >> (j * 2 + k)) & 0x1) == 0x1);
-	     bool t = (((rctInfo.tBits >> (j * 2 + k)) & 0x1) == 0x1);
-	     bool m = (((rctInfo.mBits >> (j * 2 + k)) & 0x1) == 0x1);
-	     bool q = (((rctInfo.qBits >> (j * 2 + k)) & 0x1) == 0x1);
-
-	     L1CaloRegion rgn = L1CaloRegion(rctInfo.rgnEt[j][k], o, t, m, q, rctInfo.crateID , j, k);
-	     std::cout<<"rgn pt "<< rgn.et()<<std::endl;
-             rgn.setBx(iBX);
-	     rctRegions->push_back( rgn);
-	   }
-	 }
-
-	 for(int j = 0; j < 2; j++) {
-
-	   for(int k = 0; k < 4; k++) {
-
-	     bool fg=(((rctInfo.hfQBits>> (j * 4 + k)) & 0x1)  == 0x1); 
-
-	     L1CaloRegion rgn = L1CaloRegion(rctInfo.hfEt[j][k], fg,  rctInfo.crateID , (j * 4 +  k));
-	     rgn.setBx(iBX);
-	     rctRegions->push_back(rgn);
-	   }
-	 }
-    }
-  }
-     
+  //Every event is one capture; its frame errors as counted by the decoder
+  std::auto_ptr<RCTFrameErrors> frameErrors(new RCTFrameErrors);
+  if(status == DAQSpyBlock::Ok || status == DAQSpyBlock::CorruptedLinks)
+    *frameErrors = decoder.frameErrors();
+
+  if(bxVectorOutput)
+    putBXVectors(iEvent, *rctEMCands, *rctRegions);
 
   iEvent.put(rctEMCands);
   iEvent.put(rctRegions);
   iEvent.put(rctLinkMonitor);
   iEvent.put(rctTime);
+  iEvent.put(frameErrors);
 
   cout <<dec<< "RCTToDigi::produce() " << index << endl;
 
@@ -492,151 +352,165 @@ RCTToDigi::produce(edm::Event& iEvent, const edm::EventSetup& iSetup)
 }
 
 
-  bool 
-  RCTToDigi::getBXNumbers(const uint32_t L1aBCID, const uint32_t BXsInCapture, unsigned int BCs[5], uint32_t firstBX, uint32_t lastBX) {
-
-  if (BXsInCapture > 3) {
-    if (L1aBCID == 0){
-      BCs[0]=3562; BCs[1]=3563; BCs[2]=0; BCs[3]=1; BCs[4]=2;
-    }
-    else if (L1aBCID == 1){
-      BCs[0]=3563; BCs[1]=0; BCs[2]=1; BCs[3]=2; BCs[4]=3;
-    }
-    else{
-      BCs[0]= L1aBCID - 2;
-      BCs[1]= L1aBCID - 1;
-      BCs[2]= L1aBCID - 0;
-      BCs[3]= L1aBCID + 1;
-      BCs[4]= L1aBCID + 2;
-    }
-  } else if (BXsInCapture > 1) {
-    if (L1aBCID == 0){
-      BCs[0]=3563;
-      BCs[1]=0;
-      BCs[2]=1;
-
-    }
-    else{
-      BCs[0]= L1aBCID - 1;
-      BCs[1]= L1aBCID - 0;
-      BCs[2]= L1aBCID + 1;
+/*
+ * One DAQ spy capture. The DONE flag and the event size come back in one
+ * register read, and only the words of the event are transferred.
+ *
+ * The spy firmware arms for a single L1A and holds one event in the BRAM,
+ * so every event costs one arm, poll and read. Spreading those round trips
+ * over several L1As needs a multi-L1A arm in firmware first.
+ */
 
-    }
-  }
-  else{
-    BCs[0]= L1aBCID;
+bool RCTToDigi::spyCapture(uint32_t *destination, uint32_t &eventSize){
+  ctp7Client->setValue( CTP7::daqSpyCaptureRegisters, 0,1);
+
+  //DONE and the event size come back in the same read
+  CTP7::DAQSpyCaptureRegisters daqSpyRegisters;
+  CaptureWaiter::Result result = captureWaiter.wait([this, &daqSpyRegisters]() {
+      if(!ctp7Client->getDAQSpyCaptureRegisters(&daqSpyRegisters))
+	return -1;
+      return daqSpyRegisters.DAQ_SPY_CAPTURE_DONE_REG == 1 ? 1 : 0;
+    });
+  if(result != CaptureWaiter::Done) {
+    cerr << "RCTToDigi::spyCapture() DAQ spy capture " << CaptureWaiter::resultName(result) << endl;
+    return false;
   }
 
-  firstBX = BCs[0];
-
-  //check if BXs in Capture greater than 5
-  if(BXsInCapture<5) lastBX  = BCs[BXsInCapture-1];
-  else lastBX = 0;
-
+  //The register counts 64 bit words plus a trailer word; read it all if it makes no sense
+  eventSize = daqSpyRegisters.DAQ_SPY_CAPTURE_EVENT_SIZE_REG;
+  uint32_t nWords = DAQSpyBlock::eventSizeWords(eventSize);
+  if(nWords < EVENT_HEADER_WORDS || nWords > NIntsBRAMDAQ)
+    nWords = NIntsBRAMDAQ;
+  if(!ctp7Client->getValues(CTP7::daqBuffer,0,nWords,destination)){
+    cerr << "RCTToDigi::spyCapture() Error reading DAQ from CTP7" << endl;
+    return false;
+  }
+  memset(destination + nWords, 0, (NIntsBRAMDAQ - nWords) * sizeof(uint32_t));
   return true;
 }
 
-  bool RCTToDigi::decodeCapturedLinkID(uint32_t capturedValue, uint32_t &crateNumber, uint32_t &linkNumber, bool &even)
-  {
-    
-    //if crateNumber not valid set to 0xFF
-    crateNumber = ( capturedValue >> 8 ) & 0xFF;
-    if(crateNumber > 17)
-      crateNumber = 0xFF;
-    
-    //if linkNumber not valid set to 0xFF
-    linkNumber = ( capturedValue ) & 0xFF;
-
-    if(linkNumber > 12)
-      linkNumber = 0xFF;
-    
-    if((linkNumber&0x1) == 0)
-      even=true;
-    else
-      even=false;
-    
-    return true;
-  };
-
 /*
- * This reads in a file of form testFile.txt (see test directory for example)
- * and outputs a dump of the same form that would be received by a CTP7 Capture
+ * Validate the DAQ buffer and decode it in to the collections. Links and
+ * BXs that fail the checks are left out; an unusable buffer (truncated,
+ * no header) gives empty collections instead of no event.
  */
- 
-bool RCTToDigi::scanInDAQData(uint32_t tempBuffer[NIntsBRAMDAQ]){
 
-  FILE *fptr = fopen(fileName, "r");
+DAQSpyBlock::Status RCTToDigi::unpackDAQ(L1CaloEmCollection &emCands, L1CaloRegionCollection &regions){
 
-  if(fptr == NULL) {
-    cout<<"Error: Could not open emulator input file "<<endl;
-    return false;
-  } 
+  //The event size register counts 64 bit words plus a trailer word, as header word 0 does
+  DAQSpyBlock::Status status = daqBlock.parse(buffer, NIntsBRAMDAQ, DAQSpyBlock::eventSizeWords(daqEventSize));
+  bxWindow.set(0, 0);
+  if(status != DAQSpyBlock::Ok && status != DAQSpyBlock::CorruptedLinks) {
+    cerr << "RCTToDigi::produce() DAQ buffer " << DAQSpyBlock::statusName(status) << ": header needs "
+	 << daqBlock.expectedWords() << " words, event size " << DAQSpyBlock::eventSizeWords(daqEventSize) << endl;
+    return status;
+  }
 
+  if(daqBlock.sizeMismatch())
+    cerr << "RCTToDigi::produce() Warning: " << daqBlock.nBX() << " BXs take " << daqBlock.expectedWords()
+	 << " words, header event size " << daqBlock.headerWords() << ", event size register "
+	 << DAQSpyBlock::eventSizeWords(daqEventSize) << endl;
+
+  uint32_t nBX = daqBlock.nBX(); 
+  uint32_t L1aBCID = daqBlock.l1aBCID();
+  bxWindow.set(L1aBCID, nBX);
+     
+  cout << "L1ID = " << daqBlock.l1ID() << " L1A BCID = " << L1aBCID << " BXs in capture = " << nBX << " CTP7 DAQ FW = " << daqBlock.firmwareVersion()<<endl;
+  cout << "BCIDs " << bxWindow.firstBCID() << " to " << bxWindow.lastBCID() << endl;
+  
+  //Step 1: Channel headers are decoded in place by daqBlock, frames stay in buffer
+  if(daqBlock.crcErrorLinks() != 0)
+    std::cout<<"WARNING CRC ErrorFound on links "<<std::hex<<daqBlock.crcErrorLinks()<<std::dec<<std::endl;
 
-  int ret = 0; 
+  //Step 2: Decode every (crate, BX) of the crates found by daqBlock.parse, in parallel
+  status = decoder.decode(daqBlock);
+  uint32_t nCratesFound = decoder.cratesFound();
+  
+  if(nCratesFound != NRCTCrates)
+    cerr << "Warning -- only found "<< nCratesFound << " valid crates" << endl;
+  if(nCratesFound != NRCTCrates || daqBlock.hasDuplicates() || status != DAQSpyBlock::Ok)
+    daqBlock.reportCrates("RCTToDigi");
+  if(decoder.badUnits() != 0)
+    cerr << "RCTToDigi::produce() " << decoder.badUnits() << " crate BXs with bad BX bytes left out, corrupted links "
+	 << std::hex << decoder.corruptedLinks() << std::dec << endl;
+  
+  if(infoDumper.sample()) {
+    RCTInfo rctInfo[NRCTCrates];
+    for (uint32_t iBX=0; iBX<nBX; iBX++){
+      decoder.bxInfo(iBX, rctInfo);
+      const RCTInfoPacked *frames = decoder.bxFrames(iBX);
+      for(uint32_t i = 0; i < nCratesFound; i++)
+	if(decoder.crateGood(iBX, i))
+	  infoDumper.record(daqBlock.l1ID(), iBX, rctInfo[i].crateID, &rctInfo[i], frames[i].evenFiber(), frames[i].oddFiber());
+      infoDumper.endGroup();
+    }
+    infoDumper.flush();
+  }
 
-  int i = 0;
-  unsigned int tInt = 0;
-  char line[100];
+  //Step 3: Create Collections from RCTInfo Objects, BX by BX in crate order
+  decoder.fillCollections(emCands, regions);
 
-  while (1) {
-    ret = fscanf(fptr, "%s", line);
+  return status;
+}
 
-    if(ret == EOF)
-      break;
-    
-    if(i == NIntsBRAMDAQ)
-      break;
+/*
+ * Copy a flat collection, written BX by BX, in to a BXVector. Each run of
+ * one BX is sized once and then set; push_back(bx, obj) would shift the
+ * offsets of every later BX for each object.
+ */
 
-    sscanf(line, "%x", &tInt);
-    tempBuffer[i] = tInt;
-    //std::cout<<"i "<< i<< " "<<std::hex<< tempBuffer[i] <<endl;
-    i++;
+template <class T>
+static void fillBXVector(const BXWindow &bxWindow, const std::vector<T> &flat, BXVector<T> &out){
+  for(uint32_t first = 0, last; first < flat.size(); first = last) {
+    for(last = first + 1; last < flat.size() && flat[last].bx() == flat[first].bx(); last++);
+    int bx = bxWindow.relativeBX(flat[first].bx());
+    out.resize(bx, last - first);
+    for(uint32_t i = first; i < last; i++) {
+      T object = flat[i];
+      object.setBx(bx);
+      out.set(bx, i - first, object);
+    }
   }
-
-  fclose(fptr);
-  return true;
-  
 }
 
-void RCTToDigi::printDAQToFile(){
-  char outputFile[40];
-  sprintf(outputFile,"outputFileDAQ.txt");
-  FILE *fptr = fopen(outputFile, "w");
-  for(unsigned int i = 0; i< NIntsBRAMDAQ; i++){
-    fprintf( fptr, "%08x ", buffer[i] );
-    //printf("%08x ", buffer[i]);
-    if(i%6==5)
-      fputs("\n",fptr);
-  }
+/*
+ * Copy the decoded window in to BXVectors. The flat collections number
+ * the BXs from 0 at the start of the window; here they count from the L1A.
+ */
+
+void RCTToDigi::putBXVectors(edm::Event &iEvent, const L1CaloEmCollection &emCands, const L1CaloRegionCollection &regions){
+
+  std::auto_ptr<L1CaloEmCandBxCollection> rctEMCands(new L1CaloEmCandBxCollection);
+  std::auto_ptr<L1CaloRegionBxCollection> rctRegions(new L1CaloRegionBxCollection);
+  rctEMCands->setBXRange(bxWindow.firstBX(), bxWindow.lastBX());
+  rctRegions->setBXRange(bxWindow.firstBX(), bxWindow.lastBX());
 
-  fclose(fptr);
+  fillBXVector(bxWindow, emCands, *rctEMCands);
+  fillBXVector(bxWindow, regions, *rctRegions);
 
+  iEvent.put(rctEMCands);
+  iEvent.put(rctRegions);
 }
 
 /*
- * Check CTP7 Capture Status to see if Capture was Successful
- * After 5 attempts return false. TCP/IP communication takes 
+ * Poll the CTP7 capture status, backing off between polls, until the
+ * capture is done or captureTimeoutMs has passed.
  */
 
 bool RCTToDigi::waitForCaptureSuccess(){
 
-  int nAttempts = 0;
-  CTP7::CaptureStatus captureStatusTemp;
-  CTP7::CaptureStatus *captureStatus;
-  captureStatus = &captureStatusTemp;
-
-  while(nAttempts<5){
+  CTP7::CaptureStatus captureStatus;
+  CaptureWaiter::Result result = captureWaiter.wait([this, &captureStatus]() {
+      if(!ctp7Client->getCaptureStatus(&captureStatus))
+	return -1;
+      return captureStatus == CTP7::Done ? 1 : 0;
+    });
 
-    ctp7Client->getCaptureStatus(captureStatus);
-
-    if(*captureStatus == CTP7::Done)
-      return true;
-
-    nAttempts++;
+  if(result != CaptureWaiter::Done) {
+    cerr << "RCTToDigi::waitForCaptureSuccess() Capture " << CaptureWaiter::resultName(result) << endl;
+    return false;
   }
-
-  return false;
+  return true;
 }
 
 // ------------ method called once each job just before starting event loop  ------------
@@ -644,20 +518,37 @@ void
 RCTToDigi::beginJob()
 {
   cout << "RCTToDigi::beginJob()" << endl;
+  if(test && testFile.size() > 8 && testFile.compare(testFile.size() - 8, 8, ".ctp7cap") == 0)
+    captureReader.open(testFile);
+  if(dumpWriter != 0) {
+    if(!test && !captureFile.empty())
+      dumpWriter->openCaptureFile(captureFile, compressCaptureFile);
+    if(asyncDump)
+      dumpWriter->start();
+  }
 }
 
 // ------------ method called once each job just after ending the event loop  ------------
 void 
 RCTToDigi::endJob() {
   cout << "RCTToDigi::endJob()" << endl;
+  if(dumpWriter != 0) {
+    dumpWriter->stop();
+    dumpWriter->printStats("RCTToDigi");
+  }
+  captureWaiter.printHistogram("RCTToDigi");
+  infoDumper.flush();
 }
 
 // ------------ method called when starting to processes a run  ------------
 
 void
-RCTToDigi::beginRun(edm::Run const&, edm::EventSetup const&)
+RCTToDigi::beginRun(edm::Run const& iRun, edm::EventSetup const&)
 {
   cout << "RCTToDigi::beginRun()" << endl;
+  metadata.setRun(iRun.run());
+  if(!test && !metadata.readFirmware(ctp7Client))
+    cout << "RCTToDigi::beginRun() Could not read firmware GITHASH" << endl;
 }
 
  
@@ -697,6 +588,20 @@ RCTToDigi::fillDescriptions(edm::ConfigurationDescriptions& descriptions) {
   desc.addUntracked<std::string>("ctp7Host", "localhost")->setComment("CTP7 TCP/IP host name");
   desc.addUntracked<std::string>("ctp7Port", "5555")->setComment("CTP7 TCP/IP port name");
   desc.addUntracked<bool>("test", false)->setComment("Test or normal running?");
+  desc.addUntracked<std::string>("captureFile", "")->setComment("Binary .ctp7cap file to append every DAQ capture to, empty to disable");
+  desc.addUntracked<bool>("bxVectorOutput", false)->setComment("Also put BXVector collections of the readout window, BX 0 being the L1A");
+  desc.addUntracked<bool>("parallelDecode", true)->setComment("Decode crates and BXs as parallel tasks");
+  desc.addUntracked<std::string>("infoDumpFormat", "human")->setComment("Text dump format of the decoded crates: human, csv or jsonl");
+  desc.addUntracked<int>("infoDumpLevel", 0)->setComment("0 no dump, 1 decoded crates, 2 decoded crates and fiber words");
+  desc.addUntracked<unsigned int>("infoDumpPrescale", 1)->setComment("Dump one capture in this many");
+  desc.addUntracked<std::string>("infoDumpFile", "")->setComment("File to dump to, empty for stdout");
+  desc.addUntracked<bool>("compressCaptureFile", true)->setComment("Store capture file blocks FrameCodec encoded and identical blocks once");
+  desc.addUntracked<bool>("encodedTransfer", false)->setComment("Request FrameCodec encoded bulk reads from the CTP7 server. Unusable until the server implements the getEncodedValues command");
+  desc.addUntracked<bool>("asyncDump", true)->setComment("Write DAQ dumps and capture file records on a background thread");
+  desc.addUntracked<int>("dumpQueueDepth", 4)->setComment("Number of pooled capture buffers queued for the dump writer");
+  desc.addUntracked<bool>("dumpDropWhenFull", false)->setComment("Skip dumps instead of waiting when the dump writer falls behind");
+  desc.addUntracked<unsigned int>("captureTimeoutMs", 1000)->setComment("Give up waiting for a CTP7 capture after this many ms");
+  desc.addUntracked<unsigned int>("captureMaxBackoffUs", 1000)->setComment("Longest pause between CTP7 capture status polls, in us");
 }
 
 //define this as a plug-in
@@ -0,0 +1,91 @@
+#ifndef RCTFrameErrors_h
+#define RCTFrameErrors_h
+
+#include <vector>
+#include <stdint.h>
+
+/*
+ * Frame errors RCTInfoFactory found while decoding one capture: counts
+ * per error type, per type and link, per type and BX of the capture, and
+ * the first MaxSamples errors with the word that gave them away.
+ *
+ * Counting allocates nothing until the first error, so an error free
+ * decode costs nothing, and an error heavy one no console output.
+ */
+
+struct RCTFrameErrorSample {
+  RCTFrameErrorSample() : type(0), link(0), bx(0), word(0) {;}
+  RCTFrameErrorSample(uint32_t t, uint32_t l, uint32_t b, uint32_t w) : type(t), link(l), bx(b), word(w) {;}
+  uint32_t type;
+  uint32_t link;
+  uint32_t bx;
+  // First frame word for abort gap and BX byte errors, word 5 of both fibers for BC0 marks, else the check byte syndrome
+  uint32_t word;
+};
+
+class RCTFrameErrors {
+
+public:
+
+  enum Type {AbortGap = 0, BadBXByte, BC0Mismatch, BadCheckByte, NTypes};
+
+  // Two fibers per crate
+  static const uint32_t NFibers = 36;
+  static const uint32_t MaxSamples = 16;
+
+  RCTFrameErrors() {clear();}
+
+  void clear() {
+    for(uint32_t t = 0; t < NTypes; t++) counts[t] = 0;
+    linkCounts.clear();
+    bxCounts.clear();
+    samples.clear();
+  }
+
+  void add(Type type, uint32_t link, uint32_t bx, uint32_t word) {
+    counts[type]++;
+    if(link < NFibers) {
+      if(linkCounts.empty()) linkCounts.resize(NTypes * NFibers);
+      linkCounts[type * NFibers + link]++;
+    }
+    if(bxCounts.size() < (bx + 1) * NTypes) bxCounts.resize((bx + 1) * NTypes);
+    bxCounts[bx * NTypes + type]++;
+    if(samples.size() < MaxSamples) samples.push_back(RCTFrameErrorSample(type, link, bx, word));
+  }
+
+  void merge(const RCTFrameErrors &other) {
+    for(uint32_t t = 0; t < NTypes; t++) counts[t] += other.counts[t];
+    if(!other.linkCounts.empty()) {
+      if(linkCounts.empty()) linkCounts.resize(NTypes * NFibers);
+      for(uint32_t i = 0; i < linkCounts.size(); i++) linkCounts[i] += other.linkCounts[i];
+    }
+    if(bxCounts.size() < other.bxCounts.size()) bxCounts.resize(other.bxCounts.size());
+    for(uint32_t i = 0; i < other.bxCounts.size(); i++) bxCounts[i] += other.bxCounts[i];
+    for(uint32_t i = 0; i < other.samples.size() && samples.size() < MaxSamples; i++) samples.push_back(other.samples[i]);
+  }
+
+  uint32_t count(Type type) const {return counts[type];}
+  uint32_t linkCount(Type type, uint32_t link) const {return linkCounts.empty() ? 0 : linkCounts[type * NFibers + link];}
+  uint32_t bxCount(Type type, uint32_t bx) const {return (bx + 1) * NTypes > bxCounts.size() ? 0 : bxCounts[bx * NTypes + type];}
+  // BXs up to the last one with an error
+  uint32_t nBX() const {return bxCounts.size() / NTypes;}
+  const std::vector<RCTFrameErrorSample> &firstErrors() const {return samples;}
+
+  // Every type but the abort gap, which is expected once per orbit
+  uint32_t errors() const {return counts[BadBXByte] + counts[BC0Mismatch] + counts[BadCheckByte];}
+
+  static const char *typeName(uint32_t type) {
+    static const char *names[NTypes] = {"AbortGap", "BadBXByte", "BC0Mismatch", "BadCheckByte"};
+    return type < NTypes ? names[type] : "Unknown";
+  }
+
+private:
+
+  uint32_t counts[NTypes];
+  std::vector<uint32_t> linkCounts;   // [type * NFibers + link]
+  std::vector<uint32_t> bxCounts;     // [bx * NTypes + type]
+  std::vector<RCTFrameErrorSample> samples;
+
+};
+
+#endif
@@ -9,6 +9,7 @@
 #include <boost/cstdint.hpp>
 #include "DataFormats/L1Trigger/interface/BXVector.h"
 #include "L1CaloBXCollections.hh"
+#include "RCTFrameErrors.hh"
 #include "DataFormats/Common/interface/Wrapper.h"
 #include  <cstddef>
 
@@ -18,5 +19,9 @@ namespace { struct dictionary {
 
   L1CaloRegionBxCollection dummy2;
   edm::Wrapper<L1CaloRegionBxCollection> dummy3;
+
+  RCTFrameErrors dummy4;
+  std::vector<RCTFrameErrorSample> dummy5;
+  edm::Wrapper<RCTFrameErrors> dummy6;
 };
 }
@@ -23,7 +23,11 @@ process.ctp7ToDigi = cms.EDProducer('CTP7ToDigi',
                                     createLinkFile = cms.untracked.bool(True),
                                     #Note to switch to MP7 Mapping you MUST put mp7Mapping to true AND change the testFile.txt to the MP7 Pattern File Name
                                     testFile = cms.untracked.string("testFile.txt"),
-                                    mp7Mapping = cms.untracked.bool(False)
+                                    mp7Mapping = cms.untracked.bool(False),
+                                    #Set bxVectorOutput to True to pack NBXPerEvent BXs (max 170) in to each event
+                                    #as BXVector collections; maxEvents then counts windows, not BXs
+                                    bxVectorOutput = cms.untracked.bool(False),
+                                    NBXPerEvent = cms.untracked.int32(170)
                                     )
 
 process.p = cms.Path(process.ctp7ToDigi)
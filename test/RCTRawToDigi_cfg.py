@@ -0,0 +1,27 @@
+import FWCore.ParameterSet.Config as cms
+
+process = cms.Process("RCTRawToDigi")
+
+process.load("FWCore.MessageService.MessageLogger_cfi")
+
+process.maxEvents = cms.untracked.PSet( input = cms.untracked.int32(-1) )
+
+# Events are unpacked on as many threads as there are streams
+process.options = cms.untracked.PSet( numberOfThreads = cms.untracked.uint32(4),
+                                      numberOfStreams = cms.untracked.uint32(4) )
+
+process.source = cms.Source("PoolSource",
+                            fileNames = cms.untracked.vstring("file:raw.root"))
+
+process.rctRawToDigi = cms.EDProducer('RCTRawToDigi',
+                                      inputLabel = cms.untracked.InputTag("rawDataCollector"),
+                                      fedID = cms.untracked.int32(1350),
+                                      amcSlot = cms.untracked.int32(0)
+                                      )
+
+process.p = cms.Path(process.rctRawToDigi)
+
+process.o1 = cms.OutputModule("PoolOutputModule",
+                              outputCommands = cms.untracked.vstring('keep *'),
+                              fileName = cms.untracked.string('RCTRawToDigi.root'))
+process.outpath = cms.EndPath(process.o1)
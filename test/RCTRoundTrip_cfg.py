@@ -0,0 +1,42 @@
+import FWCore.ParameterSet.Config as cms
+
+# Packer/unpacker round trip: RCTToDigi decodes a DAQ buffer fixture,
+# RCTDigiToRaw packs its collections back in to an AMC13 payload and
+# RCTRawToDigi unpacks that again. The rctToDigi and rctRawToDigi
+# collections in the output should be identical; testRCTRoundTrip checks
+# the same chain field by field without the framework.
+
+process = cms.Process("RCTRoundTrip")
+
+process.load("FWCore.MessageService.MessageLogger_cfi")
+
+process.maxEvents = cms.untracked.PSet( input = cms.untracked.int32(1) )
+
+process.source = cms.Source("EmptySource")
+
+process.rctToDigi = cms.EDProducer('RCTToDigi',
+                                   ctp7Host = cms.untracked.string("127.0.0.1"),
+                                   ctp7Port = cms.untracked.string("5554"),
+                                   test = cms.untracked.bool(True),
+                                   testFile = cms.untracked.string("daqBuffers/daqBuffer-L1A-3359-nBCs-5.txt"),
+                                   infoDumpLevel = cms.untracked.int32(0)
+                                   )
+
+process.rctDigiToRaw = cms.EDProducer('RCTDigiToRaw',
+                                      inputLabel = cms.untracked.InputTag("rctToDigi"),
+                                      fedID = cms.untracked.int32(1350),
+                                      amcSlot = cms.untracked.int32(1)
+                                      )
+
+process.rctRawToDigi = cms.EDProducer('RCTRawToDigi',
+                                      inputLabel = cms.untracked.InputTag("rctDigiToRaw"),
+                                      fedID = cms.untracked.int32(1350),
+                                      amcSlot = cms.untracked.int32(1)
+                                      )
+
+process.p = cms.Path(process.rctToDigi * process.rctDigiToRaw * process.rctRawToDigi)
+
+process.o1 = cms.OutputModule("PoolOutputModule",
+                              outputCommands = cms.untracked.vstring('keep *'),
+                              fileName = cms.untracked.string('RCTRoundTrip.root'))
+process.outpath = cms.EndPath(process.o1)
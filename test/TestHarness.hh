@@ -0,0 +1,29 @@
+#ifndef TestHarness_hh
+#define TestHarness_hh
+
+/*
+ * Shared by the standalone tests: an error count, a comparison that
+ * reports the first few differences and counts them all, and a
+ * reproducible random word source.
+ */
+
+#include <stdint.h>
+#include <iostream>
+
+static uint32_t nErrors = 0;
+
+// Report the first few differences, count them all
+#define EXPECT_EQUAL(what, a, b)					\
+  do {									\
+    if((a) != (b) && nErrors++ < 20)					\
+      std::cerr << what << ": " << #a << " = " << (a) << ", " << #b << " = " << (b) << std::endl; \
+  } while(0)
+
+static inline uint32_t random32(uint32_t &x)
+{
+  //xorshift32
+  x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+  return x;
+}
+
+#endif
@@ -0,0 +1,119 @@
+/*
+ * Cross-check of CableDecoder against its scalar reference,
+ * RCTInfoFactory::produce(cableData, rctInfo).
+ *
+ * Six cables of random words are decoded both ways, for dump lengths
+ * that fill whole 8 BX steps and ones that leave a tail of 1 to 7 BXs,
+ * and unpack(iBX) must give every RCTInfo field the scalar path gives.
+ * Dumps the scalar path refuses (cables of different or odd lengths)
+ * must be refused too.
+ *
+ * Returns non-zero if any field differs.
+ */
+
+#include <stdint.h>
+#include <iostream>
+#include <vector>
+
+#include "../plugins/RCTInfo.hh"
+#include "../plugins/RCTInfoFactory.hh"
+#include "../plugins/CableDecoder.hh"
+#include "TestHarness.hh"
+
+using namespace std;
+
+static void compareInfo(uint32_t iBX, const RCTInfo &a, const RCTInfo &b)
+{
+  EXPECT_EQUAL("BX " << iBX, a.c1BC0, b.c1BC0);
+  EXPECT_EQUAL("BX " << iBX, a.c2BC0, b.c2BC0);
+  EXPECT_EQUAL("BX " << iBX, a.c3BC0, b.c3BC0);
+  EXPECT_EQUAL("BX " << iBX, a.c4BC0, b.c4BC0);
+  EXPECT_EQUAL("BX " << iBX, a.c5BC0, b.c5BC0);
+  EXPECT_EQUAL("BX " << iBX, a.c6BC0, b.c6BC0);
+  for(int j = 0; j < 4; j++) {
+    EXPECT_EQUAL("BX " << iBX, a.ieRank[j], b.ieRank[j]);
+    EXPECT_EQUAL("BX " << iBX, a.ieCard[j], b.ieCard[j]);
+    EXPECT_EQUAL("BX " << iBX, a.ieRegn[j], b.ieRegn[j]);
+    EXPECT_EQUAL("BX " << iBX, a.ieTenBit[j], b.ieTenBit[j]);
+    EXPECT_EQUAL("BX " << iBX, a.neRank[j], b.neRank[j]);
+    EXPECT_EQUAL("BX " << iBX, a.neCard[j], b.neCard[j]);
+    EXPECT_EQUAL("BX " << iBX, a.neRegn[j], b.neRegn[j]);
+    EXPECT_EQUAL("BX " << iBX, a.neTenBit[j], b.neTenBit[j]);
+  }
+  EXPECT_EQUAL("BX " << iBX, a.mBits, b.mBits);
+  EXPECT_EQUAL("BX " << iBX, a.qBits, b.qBits);
+  EXPECT_EQUAL("BX " << iBX, a.oBits, b.oBits);
+  EXPECT_EQUAL("BX " << iBX, a.tBits, b.tBits);
+  for(int j = 0; j < 2; j++)
+    for(int k = 0; k < 4; k++)
+      EXPECT_EQUAL("BX " << iBX, a.hfEt[j][k], b.hfEt[j][k]);
+  for(int j = 0; j < 7; j++) {
+    for(int k = 0; k < 2; k++) {
+      EXPECT_EQUAL("BX " << iBX, a.rgnEt[j][k], b.rgnEt[j][k]);
+      EXPECT_EQUAL("BX " << iBX, a.rgnEtTenBit[j][k], b.rgnEtTenBit[j][k]);
+    }
+  }
+  EXPECT_EQUAL("BX " << iBX, a.hfQBits, b.hfQBits);
+}
+
+int main()
+{
+  // Whole 8 BX steps, and tails of 1 to 7 BXs after none or several steps
+  const uint32_t dumps[] = {1, 3, 7, 8, 9, 16, 21, 64, 69, 1023, 1024};
+  uint32_t x = 0x2545F491;
+
+  RCTInfoFactory factory;
+  CableDecoder decoder;
+
+  for(uint32_t d = 0; d < sizeof(dumps) / sizeof(dumps[0]); d++) {
+    uint32_t nBX = dumps[d];
+    vector< vector<unsigned int> > cables(CableDecoder::NCables);
+    for(uint32_t cable = 0; cable < CableDecoder::NCables; cable++) {
+      cables[cable].resize(nBX * CableDecoder::WordsPerBX);
+      for(uint32_t i = 0; i < cables[cable].size(); i++)
+	cables[cable][i] = random32(x);
+    }
+
+    vector<RCTInfo> reference;
+    if(!factory.produce(cables, reference)) {
+      cerr << "Scalar decoder refused " << nBX << " BXs" << endl;
+      nErrors++;
+      continue;
+    }
+    CableDecoder::Status status = decoder.decode(cables);
+    if(status != CableDecoder::Ok) {
+      cerr << "CableDecoder refused " << nBX << " BXs: " << CableDecoder::statusName(status) << endl;
+      nErrors++;
+      continue;
+    }
+    EXPECT_EQUAL("nBX", decoder.nBX(), reference.size());
+
+    for(uint32_t iBX = 0; iBX < decoder.nBX() && iBX < reference.size(); iBX++) {
+      RCTInfo rctInfo;
+      decoder.unpack(iBX, rctInfo);
+      compareInfo(iBX, reference[iBX], rctInfo);
+    }
+    cout << nBX << " BXs (tail of " << nBX % 8 << ") match the scalar decoder" << endl;
+  }
+
+  // Dumps the scalar decoder refuses
+  vector< vector<unsigned int> > cables(CableDecoder::NCables, vector<unsigned int>(18, 0));
+  vector<RCTInfo> reference;
+  cables[3].resize(16);
+  EXPECT_EQUAL("different lengths", decoder.decode(cables), CableDecoder::LengthMismatch);
+  EXPECT_EQUAL("different lengths", factory.produce(cables, reference), false);
+  for(uint32_t cable = 0; cable < CableDecoder::NCables; cable++)
+    cables[cable].resize(17);
+  EXPECT_EQUAL("odd length", decoder.decode(cables), CableDecoder::OddLength);
+  EXPECT_EQUAL("odd length", factory.produce(cables, reference), false);
+  cables.pop_back();
+  EXPECT_EQUAL("five cables", decoder.decode(cables), CableDecoder::MissingCable);
+  EXPECT_EQUAL("five cables", factory.produce(cables, reference), false);
+
+  if(nErrors != 0) {
+    cerr << nErrors << " differences between CableDecoder and the scalar decoder" << endl;
+    return 1;
+  }
+  cout << "CableDecoder matches the scalar decoder" << endl;
+  return 0;
+}
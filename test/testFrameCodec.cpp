@@ -0,0 +1,180 @@
+/*
+ * FrameCodec round trip, and optionally benchmark, on the test fixtures.
+ *
+ * Every DAQ buffer in test/daqBuffers (up to the event size in its
+ * header) and every link of the link buffer files is encoded and decoded,
+ * and must come back word for word. The compression ratio of each fixture
+ * is printed; with --benchmark also the encode and decode throughput.
+ *
+ * Usage: testFrameCodec [--benchmark] [test directory]; by default the
+ * directory of this source file. Returns non-zero if any fixture fails.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../plugins/CTP7.hh"
+#include "../plugins/DAQSpyBlock.hh"
+#include "../plugins/FrameCodec.hh"
+#include "../plugins/PatternFileLoader.hh"
+
+using namespace std;
+
+static const char *daqFixtures[] = {
+  "daqBuffers/daqBuffer-L1A-211-nBCs-5-Manual_error_with-AbortGap.txt",
+  "daqBuffers/daqBuffer-L1A-211-nBCs-5-Manual_error_with-BC.txt",
+  "daqBuffers/daqBuffer-L1A-3352-nBCs-3.txt",
+  "daqBuffers/daqBuffer-L1A-3359-nBCs-5.txt",
+  "daqBuffers/daqBuffer-L1A-905-nBCs-1.txt"
+};
+
+static const char *linkFixtures[] = {
+  "testFile.txt",
+  "MP7InputBuffer.txt"
+};
+
+// With --benchmark, time the codec over at least this many words of each fixture
+static const uint64_t BenchmarkWords = 50000000;
+static bool benchmark = false;
+
+static double seconds(chrono::steady_clock::time_point start)
+{
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+/*
+ * Encode and decode the blocks of one fixture, each block nWords long;
+ * false if any block does not come back unchanged
+ */
+
+static bool roundTrip(const string &name, const vector<const uint32_t*> &blocks, uint32_t nWords)
+{
+  vector<vector<uint8_t> > coded(blocks.size());
+  vector<uint32_t> decoded(nWords);
+  size_t nBytes = 0;
+
+  for(uint32_t i = 0; i < blocks.size(); i++) {
+    coded[i].reserve(FrameCodec::maxEncodedSize(nWords));
+    nBytes += FrameCodec::encode(blocks[i], nWords, coded[i]);
+    if(coded[i].size() > FrameCodec::maxEncodedSize(nWords)) {
+      cerr << name << ": block " << i << " encoded to " << coded[i].size() << " bytes, more than maxEncodedSize" << endl;
+      return false;
+    }
+    if(!FrameCodec::decode(coded[i].data(), coded[i].size(), decoded.data(), nWords) ||
+       memcmp(decoded.data(), blocks[i], nWords * sizeof(uint32_t)) != 0) {
+      cerr << name << ": block " << i << " did not survive the round trip" << endl;
+      return false;
+    }
+    // A truncated stream must be refused rather than decoded
+    if(coded[i].size() > 1 &&
+       FrameCodec::decode(coded[i].data(), coded[i].size() - 1, decoded.data(), nWords)) {
+      cerr << name << ": block " << i << " decoded from a truncated stream" << endl;
+      return false;
+    }
+  }
+
+  uint64_t rawBytes = uint64_t(blocks.size()) * nWords * sizeof(uint32_t);
+  cout << left << setw(68) << name << right
+       << setw(9) << rawBytes << setw(8) << nBytes
+       << fixed << setprecision(1)
+       << setw(8) << double(rawBytes) / nBytes;
+  if(!benchmark) {
+    cout << endl;
+    return true;
+  }
+
+  uint32_t repeats = BenchmarkWords / (uint64_t(blocks.size()) * nWords) + 1;
+
+  vector<uint8_t> scratch;
+  scratch.reserve(FrameCodec::maxEncodedSize(nWords));
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  for(uint32_t r = 0; r < repeats; r++) {
+    for(uint32_t i = 0; i < blocks.size(); i++) {
+      scratch.clear();
+      FrameCodec::encode(blocks[i], nWords, scratch);
+    }
+  }
+  double encodeTime = seconds(start);
+
+  bool status = true;
+  start = chrono::steady_clock::now();
+  for(uint32_t r = 0; r < repeats; r++) {
+    for(uint32_t i = 0; i < blocks.size(); i++)
+      status = FrameCodec::decode(coded[i].data(), coded[i].size(), decoded.data(), nWords) && status;
+  }
+  double decodeTime = seconds(start);
+
+  double megabytes = double(rawBytes) * repeats / 1e6;
+  cout << setw(10) << megabytes / encodeTime
+       << setw(10) << megabytes / decodeTime << endl;
+  return status;
+}
+
+int main(int argc, char **argv)
+{
+  string directory = __FILE__;
+  directory = directory.substr(0, directory.find_last_of('/') + 1);
+  for(int i = 1; i < argc; i++) {
+    if(strcmp(argv[i], "--benchmark") == 0)
+      benchmark = true;
+    else
+      directory = string(argv[i]) + "/";
+  }
+
+  PatternFileLoader loader;
+  int failures = 0;
+
+  cout << left << setw(68) << "fixture" << right << setw(9) << "bytes" << setw(8) << "coded"
+       << setw(8) << "ratio";
+  if(benchmark)
+    cout << setw(10) << "enc MB/s" << setw(10) << "dec MB/s";
+  cout << endl;
+
+  for(uint32_t f = 0; f < sizeof(daqFixtures) / sizeof(daqFixtures[0]); f++) {
+    static uint32_t daqBuffer[NIntsInDAQBuffer];
+    memset(daqBuffer, 0, sizeof(daqBuffer));
+    string fileName = directory + daqFixtures[f];
+    if(!loader.loadWords(fileName, daqBuffer, NIntsInDAQBuffer)) {
+      cerr << "Cannot read " << fileName << endl;
+      failures++;
+      continue;
+    }
+
+    // Only the event is transferred, not the rest of the spy buffer
+    uint32_t nWords = DAQSpyBlock::eventSizeWords(daqBuffer[0] & 0x000FFFFF);
+    if(nWords == 0 || nWords > NIntsInDAQBuffer) nWords = NIntsInDAQBuffer;
+
+    vector<const uint32_t*> blocks(1, daqBuffer);
+    if(!roundTrip(daqFixtures[f], blocks, nWords))
+      failures++;
+  }
+
+  for(uint32_t f = 0; f < sizeof(linkFixtures) / sizeof(linkFixtures[0]); f++) {
+    static uint32_t linkBuffer[NILinks][NIntsPerLink];
+    string fileName = directory + linkFixtures[f];
+    if(!loader.loadLinks(fileName, linkBuffer)) {
+      cerr << "Cannot read " << fileName << endl;
+      failures++;
+      continue;
+    }
+
+    // One block per link, as the links are read and archived
+    vector<const uint32_t*> blocks;
+    for(uint32_t link = 0; link < NILinks; link++)
+      blocks.push_back(linkBuffer[link]);
+    if(!roundTrip(linkFixtures[f], blocks, NIntsPerLink))
+      failures++;
+  }
+
+  if(failures != 0) {
+    cerr << failures << " fixtures failed the FrameCodec round trip" << endl;
+    return 1;
+  }
+  cout << "All fixtures survived the FrameCodec round trip" << endl;
+  return 0;
+}
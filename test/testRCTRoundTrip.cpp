@@ -0,0 +1,168 @@
+/*
+ * Packer/unpacker round trip without the framework, the chain
+ * RCTRoundTrip_cfg.py runs through RCTDigiToRaw and RCTRawToDigi.
+ *
+ * Synthetic crates (DAQSpyPacker::fillSynthetic) are packed, parsed with
+ * DAQSpyBlock and decoded in to collections with DAQSpyDecoder. The
+ * collections are turned back in to crates with fromCollections, which
+ * must give the synthetic crates back, and packed and decoded again,
+ * which must give the same collections field by field.
+ *
+ * Returns non-zero if any field differs.
+ */
+
+#include <stdint.h>
+#include <iostream>
+#include <vector>
+
+#include "DataFormats/L1CaloTrigger/interface/L1CaloCollections.h"
+
+#include "../plugins/RCTInfo.hh"
+#include "../plugins/DAQSpyBlock.hh"
+#include "../plugins/DAQSpyDecoder.hh"
+#include "../plugins/DAQSpyPacker.hh"
+#include "TestHarness.hh"
+
+using namespace std;
+
+/*
+ * Pack nBX BXs of crates and decode them back in to collections
+ */
+
+static bool packAndDecode(const vector<RCTInfo> &info, uint32_t nBX, uint32_t l1ID, uint32_t bcid,
+			  vector<uint32_t> &block, L1CaloEmCollection &emCands, L1CaloRegionCollection &regions)
+{
+  DAQSpyPacker packer;
+  block.assign(DAQSpyPacker::blockWords(nBX), 0);
+  uint32_t nWords = packer.pack(&info[0], nBX, l1ID, bcid, &block[0], block.size());
+  if(nWords != block.size()) {
+    cerr << "pack() used " << nWords << " of " << block.size() << " words" << endl;
+    return false;
+  }
+
+  DAQSpyBlock daqBlock;
+  DAQSpyBlock::Status status = daqBlock.parse(&block[0], nWords);
+  if(status != DAQSpyBlock::Ok || daqBlock.sizeMismatch()) {
+    cerr << "parse() " << DAQSpyBlock::statusName(status) << (daqBlock.sizeMismatch() ? ", size mismatch" : "") << endl;
+    return false;
+  }
+  EXPECT_EQUAL("header", daqBlock.nBX(), nBX);
+  EXPECT_EQUAL("header", daqBlock.l1ID(), l1ID);
+  EXPECT_EQUAL("header", daqBlock.l1aBCID(), bcid);
+
+  DAQSpyDecoder decoder;
+  status = decoder.decode(daqBlock);
+  if(status != DAQSpyBlock::Ok || decoder.badUnits() != 0) {
+    cerr << "decode() " << DAQSpyBlock::statusName(status) << ", " << decoder.badUnits() << " bad crates" << endl;
+    return false;
+  }
+  EXPECT_EQUAL("decode", decoder.cratesFound(), uint32_t(NRCTCrates));
+
+  emCands.clear();
+  regions.clear();
+  decoder.fillCollections(emCands, regions);
+  return true;
+}
+
+// The fields of a crate the collections carry
+static void compareInfo(uint32_t unit, const RCTInfo &a, const RCTInfo &b)
+{
+  for(int j = 0; j < 4; j++) {
+    EXPECT_EQUAL("crate " << unit, a.ieRank[j], b.ieRank[j]);
+    EXPECT_EQUAL("crate " << unit, a.ieCard[j], b.ieCard[j]);
+    EXPECT_EQUAL("crate " << unit, a.ieRegn[j], b.ieRegn[j]);
+    EXPECT_EQUAL("crate " << unit, a.neRank[j], b.neRank[j]);
+    EXPECT_EQUAL("crate " << unit, a.neCard[j], b.neCard[j]);
+    EXPECT_EQUAL("crate " << unit, a.neRegn[j], b.neRegn[j]);
+  }
+  for(int j = 0; j < 7; j++)
+    for(int k = 0; k < 2; k++)
+      EXPECT_EQUAL("crate " << unit, a.rgnEt[j][k], b.rgnEt[j][k]);
+  for(int j = 0; j < 2; j++)
+    for(int k = 0; k < 4; k++)
+      EXPECT_EQUAL("crate " << unit, a.hfEt[j][k], b.hfEt[j][k]);
+  EXPECT_EQUAL("crate " << unit, a.oBits, b.oBits);
+  EXPECT_EQUAL("crate " << unit, a.tBits, b.tBits);
+  EXPECT_EQUAL("crate " << unit, a.mBits, b.mBits);
+  EXPECT_EQUAL("crate " << unit, a.hfQBits, b.hfQBits);
+}
+
+static void compareCollections(const L1CaloEmCollection &emA, const L1CaloRegionCollection &rgnA,
+			       const L1CaloEmCollection &emB, const L1CaloRegionCollection &rgnB)
+{
+  EXPECT_EQUAL("em", emA.size(), emB.size());
+  for(uint32_t i = 0; i < emA.size() && i < emB.size(); i++) {
+    const L1CaloEmCand &a = emA[i], &b = emB[i];
+    EXPECT_EQUAL("em " << i, a.rank(), b.rank());
+    EXPECT_EQUAL("em " << i, a.rctCard(), b.rctCard());
+    EXPECT_EQUAL("em " << i, a.rctRegion(), b.rctRegion());
+    EXPECT_EQUAL("em " << i, a.rctCrate(), b.rctCrate());
+    EXPECT_EQUAL("em " << i, a.isolated(), b.isolated());
+    EXPECT_EQUAL("em " << i, a.bx(), b.bx());
+  }
+
+  EXPECT_EQUAL("region", rgnA.size(), rgnB.size());
+  for(uint32_t i = 0; i < rgnA.size() && i < rgnB.size(); i++) {
+    const L1CaloRegion &a = rgnA[i], &b = rgnB[i];
+    EXPECT_EQUAL("region " << i, a.et(), b.et());
+    EXPECT_EQUAL("region " << i, a.overFlow(), b.overFlow());
+    EXPECT_EQUAL("region " << i, a.tauVeto(), b.tauVeto());
+    EXPECT_EQUAL("region " << i, a.mip(), b.mip());
+    EXPECT_EQUAL("region " << i, a.quiet(), b.quiet());
+    EXPECT_EQUAL("region " << i, a.fineGrain(), b.fineGrain());
+    EXPECT_EQUAL("region " << i, a.rctCrate(), b.rctCrate());
+    EXPECT_EQUAL("region " << i, a.rctCard(), b.rctCard());
+    EXPECT_EQUAL("region " << i, a.rctRegionIndex(), b.rctRegionIndex());
+    EXPECT_EQUAL("region " << i, a.isHf(), b.isHf());
+    EXPECT_EQUAL("region " << i, a.bx(), b.bx());
+  }
+}
+
+int main()
+{
+  const uint32_t windows[] = {1, 3, 5, 10};
+
+  for(uint32_t w = 0; w < sizeof(windows) / sizeof(windows[0]); w++) {
+    uint32_t nBX = windows[w];
+    uint32_t l1ID = 3359 + w;
+    uint32_t bcid = 211 * (w + 1);
+
+    vector<RCTInfo> synthetic(nBX * NRCTCrates);
+    DAQSpyPacker::fillSynthetic(&synthetic[0], synthetic.size(), 0x1234567 + w);
+
+    vector<uint32_t> blockA, blockB;
+    L1CaloEmCollection emA, emB;
+    L1CaloRegionCollection rgnA, rgnB;
+    if(!packAndDecode(synthetic, nBX, l1ID, bcid, blockA, emA, rgnA)) {
+      nErrors++;
+      continue;
+    }
+    EXPECT_EQUAL("em", emA.size(), nBX * NRCTCrates * DAQSpyDecoder::EmCandsPerCrate);
+    EXPECT_EQUAL("region", rgnA.size(), nBX * NRCTCrates * DAQSpyDecoder::RegionsPerCrate);
+
+    vector<RCTInfo> info;
+    if(!DAQSpyPacker::fromCollections(emA, rgnA, nBX, info)) {
+      cerr << "fromCollections() left candidates out for " << nBX << " BXs" << endl;
+      nErrors++;
+    }
+    EXPECT_EQUAL("fromCollections", info.size(), synthetic.size());
+    for(uint32_t unit = 0; unit < info.size() && unit < synthetic.size(); unit++)
+      compareInfo(unit, synthetic[unit], info[unit]);
+
+    if(!packAndDecode(info, nBX, l1ID, bcid, blockB, emB, rgnB)) {
+      nErrors++;
+      continue;
+    }
+    compareCollections(emA, rgnA, emB, rgnB);
+    EXPECT_EQUAL("block", (blockA == blockB), true);
+
+    cout << nBX << " BXs: " << emA.size() << " EM candidates and " << rgnA.size() << " regions round tripped" << endl;
+  }
+
+  if(nErrors != 0) {
+    cerr << nErrors << " differences in the packer/unpacker round trip" << endl;
+    return 1;
+  }
+  cout << "Packer/unpacker round trip OK" << endl;
+  return 0;
+}